@@ -14,48 +14,240 @@
 #define LLVM_EXECUTIONENGINE_ORC_KALEIDOSCOPEJIT_H
 
 #include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Bitcode/BitcodeReader.h"
 #include "llvm/ExecutionEngine/JITSymbol.h"
+#include "llvm/ExecutionEngine/Orc/CompileOnDemandLayer.h"
 #include "llvm/ExecutionEngine/Orc/CompileUtils.h"
 #include "llvm/ExecutionEngine/Orc/Core.h"
 #include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
 #include "llvm/ExecutionEngine/Orc/ExecutorProcessControl.h"
 #include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
+#include "llvm/ExecutionEngine/Orc/IRTransformLayer.h"
+#include "llvm/ExecutionEngine/Orc/IndirectionUtils.h"
 #include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/MapperJITLinkMemoryManager.h"
+#include "llvm/ExecutionEngine/Orc/ObjectLinkingLayer.h"
 #include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
 #include "llvm/ExecutionEngine/Orc/Shared/ExecutorSymbolDef.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Support/CodeGen.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Transforms/IPO/Internalize.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <memory>
+#include <string>
+#include <vector>
+
+#include "ir/IROptimizer.h"
+#include "jit/CachedIRCompiler.h"
+#include "jit/FunctionEvictionManager.h"
+#include "jit/PersistentObjectCache.h"
+#include "jit/ProfileGuidedOptimizer.h"
+#include "jit/SlabMemoryMapper.h"
+#include "jit/ThreadPoolTaskDispatcher.h"
+#include "runtime/ParallelFor.h"
 
 namespace llvm::orc {
 
+    struct JITOptions {
+        // Generate code for the host CPU and all of its features (AVX2, FMA, AVX-512, ...). When disabled the code
+        // targets the generic CPU of the triple and runs on any machine of the same architecture.
+        bool targetHostCpu = true;
+        // Optimization level of the backend.
+        CodeGenOptLevel codeGenOptLevel = CodeGenOptLevel::Default;
+        // Modules added with addLazyModule() get a stub per function; a function is compiled on its first call.
+        bool lazyCompilation = false;
+        // Run the IR optimization pipeline on every module before it is compiled.
+        bool optimizeIR = true;
+        // Worker threads which optimize and compile modules; 0 compiles on the thread looking up the symbols.
+        unsigned compileThreads = hardware_concurrency().compute_thread_count();
+        // Directory of the persistent object cache; empty disables the cache.
+        std::string objectCacheDir;
+        // Link objects with JITLink into slabs of slabSize bytes instead of RuntimeDyld with pages mapped per object.
+        bool jitLink = false;
+        size_t slabSize = 64 * 1024 * 1024;
+        // Ask for transparent huge pages for the slabs, fewer iTLB misses when calling code of many small modules.
+        bool hugePages = false;
+        // Limit of the linked JIT code in bytes, 0 disables it. Every function gets a stub and a resource tracker of
+        // its own and the least recently called functions are evicted by evictColdFunctions(). Implies jitLink.
+        std::uint64_t memoryLimit = 0;
+        // Calls after which a function instrumented with block and branch counters is compiled again with the
+        // collected profile by reoptimizeHotFunctions(), 0 disables profiling. Ignored under the memory limit.
+        std::uint64_t profileWarmupCalls = 0;
+        // Resolve undefined symbols against all symbols of the process with dlsym. When disabled only explicitly
+        // defined symbols, such as registered host functions, are found.
+        bool searchProcessSymbols = true;
+    };
+
     class KaleidoscopeJIT {
     private:
         std::unique_ptr<ExecutionSession> executionSession;
+        JITTargetMachineBuilder targetMachineBuilder;
         DataLayout dataLayout;
         MangleAndInterner mangleAndInterpret;
-        RTDyldObjectLinkingLayer objectLinkingLayer;
+        const SlabMemoryMapper *memoryMapper;
+        std::unique_ptr<ObjectLayer> objectLinkingLayer;
+        std::unique_ptr<PersistentObjectCache> objectCache;
         IRCompileLayer compileLayer;
+        IRTransformLayer optimizeLayer;
+        bool optimizeIR;
+        std::atomic<std::int64_t> optimizeNanoseconds{0};
+        // Bitcode of builtins linked into every module which references them.
+        std::vector<std::string> builtinBitcodes;
+        std::unique_ptr<LazyCallThroughManager> lazyCallThroughManager;
+        std::unique_ptr<CompileOnDemandLayer> compileOnDemandLayer;
+        std::unique_ptr<FunctionEvictionManager> evictionManager;
+        std::unique_ptr<ProfileGuidedOptimizer> profileGuidedOptimizer;
         JITDylib &jitLib;
 
+        static void handleLazyCallThroughError() {
+            errs() << "LazyCallThrough error: Could not find function body";
+            exit(1);
+        }
+
+        static std::unique_ptr<ObjectLayer> createObjectLinkingLayer(ExecutionSession &executionSession,
+                                                                     const Triple &targetTriple,
+                                                                     std::unique_ptr<SlabMemoryMapper> memoryMapper) {
+            if (memoryMapper != nullptr) {
+                const auto slabSize = memoryMapper->getSlabSize();
+                return std::make_unique<ObjectLinkingLayer>(
+                        executionSession,
+                        std::make_unique<jitlink::MapperJITLinkMemoryManager>(slabSize, std::move(memoryMapper)));
+            }
+            auto objectLinkingLayer = std::make_unique<RTDyldObjectLinkingLayer>(
+                    executionSession, []() { return std::make_unique<SectionMemoryManager>(); });
+            if (targetTriple.isOSBinFormatCOFF()) {
+                objectLinkingLayer->setOverrideObjectFlagsWithResponsibilityFlags(true);
+                objectLinkingLayer->setAutoClaimResponsibilityForObjectSymbols(true);
+            }
+            return objectLinkingLayer;
+        }
+
+        // Copies the builtins the module calls into it as internal functions, so that they can be inlined. Copies
+        // which aren't inlined stay private to the module.
+        Error linkBuiltins(Module &module) const {
+            for (const auto &bitcode: builtinBitcodes) {
+                auto builtins = parseBitcodeFile(MemoryBufferRef(bitcode, "builtins"), module.getContext());
+                if (!builtins) {
+                    return builtins.takeError();
+                }
+                (*builtins)->setDataLayout(module.getDataLayout());
+                (*builtins)->setTargetTriple(module.getTargetTriple());
+                const auto failed = Linker::linkModules(
+                        module, std::move(*builtins), Linker::LinkOnlyNeeded,
+                        [](Module &linkedModule, const StringSet<> &linkedNames) {
+                            internalizeModule(linkedModule, [&linkedNames](const GlobalValue &value) {
+                                return !value.hasName() || !linkedNames.contains(value.getName());
+                            });
+                        });
+                if (failed) {
+                    return createStringError(inconvertibleErrorCode(), "can't link the builtins into a module");
+                }
+            }
+            return Error::success();
+        }
+
+        // Runs on the compile threads, each with its own target machine.
+        Expected<ThreadSafeModule> optimizeModule(ThreadSafeModule threadSafeModule) {
+            if (!builtinBitcodes.empty()) {
+                if (auto error = threadSafeModule.withModuleDo([this](Module &module) {
+                    return linkBuiltins(module);
+                })) {
+                    return std::move(error);
+                }
+            }
+            if (!optimizeIR) {
+                return std::move(threadSafeModule);
+            }
+            auto targetMachine = static_cast<CachedIRCompiler &>(compileLayer.getCompiler()).getTargetMachine();
+            if (!targetMachine) {
+                return targetMachine.takeError();
+            }
+            const auto start = std::chrono::steady_clock::now();
+            threadSafeModule.withModuleDo([&targetMachine](Module &module) {
+                ::optimizeModule(module, *targetMachine);
+            });
+            optimizeNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+            return std::move(threadSafeModule);
+        }
+
     public:
         KaleidoscopeJIT(std::unique_ptr<ExecutionSession> executionSession,
                         JITTargetMachineBuilder targetMachineBuilder,
-                        const DataLayout &dataLayout)
+                        const DataLayout &dataLayout,
+                        const bool optimizeIR = true,
+                        std::unique_ptr<LazyCallThroughManager> lazyCallThroughManager = nullptr,
+                        std::unique_ptr<PersistentObjectCache> objectCache = nullptr,
+                        std::unique_ptr<SlabMemoryMapper> memoryMapper = nullptr,
+                        const std::uint64_t memoryLimit = 0,
+                        const std::uint64_t profileWarmupCalls = 0,
+                        const bool searchProcessSymbols = true)
                 : executionSession(std::move(executionSession)),
+                  targetMachineBuilder(targetMachineBuilder),
                   dataLayout(dataLayout),
                   mangleAndInterpret(*this->executionSession, this->dataLayout),
-                  objectLinkingLayer(*this->executionSession,
-                                     []() { return std::make_unique<SectionMemoryManager>(); }),
-                  compileLayer(*this->executionSession, objectLinkingLayer,
-                               std::make_unique<ConcurrentIRCompiler>(std::move(targetMachineBuilder))),
+                  memoryMapper(memoryMapper.get()),
+                  objectLinkingLayer(createObjectLinkingLayer(*this->executionSession,
+                                                              targetMachineBuilder.getTargetTriple(),
+                                                              std::move(memoryMapper))),
+                  objectCache(std::move(objectCache)),
+                  compileLayer(*this->executionSession, *objectLinkingLayer,
+                               std::make_unique<CachedIRCompiler>(targetMachineBuilder, this->objectCache.get())),
+                  optimizeLayer(*this->executionSession, compileLayer,
+                                [this](ThreadSafeModule threadSafeModule, const MaterializationResponsibility &) {
+                                    return optimizeModule(std::move(threadSafeModule));
+                                }),
+                  optimizeIR(optimizeIR),
+                  lazyCallThroughManager(std::move(lazyCallThroughManager)),
                   jitLib(this->executionSession->createBareJITDylib("<main>")) {
-            jitLib.addGenerator(cantFail(DynamicLibrarySearchGenerator::GetForCurrentProcess(
-                    dataLayout.getGlobalPrefix())));
-            if (targetMachineBuilder.getTargetTriple().isOSBinFormatCOFF()) {
-                objectLinkingLayer.setOverrideObjectFlagsWithResponsibilityFlags(true);
-                objectLinkingLayer.setAutoClaimResponsibilityForObjectSymbols(true);
+            if (this->lazyCallThroughManager != nullptr) {
+                compileOnDemandLayer = std::make_unique<CompileOnDemandLayer>(
+                        *this->executionSession, optimizeLayer, *this->lazyCallThroughManager,
+                        createLocalIndirectStubsManagerBuilder(targetMachineBuilder.getTargetTriple()));
+                if (memoryLimit > 0 && this->memoryMapper != nullptr) {
+                    evictionManager = std::make_unique<FunctionEvictionManager>(
+                            *this->executionSession, optimizeLayer, jitLib, mangleAndInterpret,
+                            *this->lazyCallThroughManager,
+                            createLocalIndirectStubsManagerBuilder(targetMachineBuilder.getTargetTriple())(),
+                            *this->memoryMapper, memoryLimit);
+                } else if (profileWarmupCalls > 0) {
+                    profileGuidedOptimizer = std::make_unique<ProfileGuidedOptimizer>(
+                            *this->executionSession, optimizeLayer, jitLib, mangleAndInterpret,
+                            *this->lazyCallThroughManager,
+                            createLocalIndirectStubsManagerBuilder(targetMachineBuilder.getTargetTriple())(),
+                            profileWarmupCalls);
+                }
+            }
+            // The runtime of the language is there whether or not scripts see the symbols of the process. Besides
+            // parallel loops it holds the libm functions which the backend lowers math builtins without a native
+            // instruction to, e.g. llvm.sin, and the memory functions which loop idioms become.
+            const auto callable = [](auto *const function) {
+                return ExecutorSymbolDef(ExecutorAddr::fromPtr(function),
+                                         JITSymbolFlags::Exported | JITSymbolFlags::Callable);
+            };
+            cantFail(jitLib.define(absoluteSymbols(SymbolMap{
+                {mangleAndInterpret(parallelForSymbol), callable(&simple_ast_parallel_for)},
+                {mangleAndInterpret("sin"), callable(static_cast<double (*)(double)>(&::sin))},
+                {mangleAndInterpret("exp"), callable(static_cast<double (*)(double)>(&::exp))},
+                {mangleAndInterpret("pow"), callable(static_cast<double (*)(double, double)>(&::pow))},
+                {mangleAndInterpret("floor"), callable(static_cast<double (*)(double)>(&::floor))},
+                {mangleAndInterpret("fma"), callable(static_cast<double (*)(double, double, double)>(&::fma))},
+                {mangleAndInterpret("memset"), callable(&::memset)},
+                {mangleAndInterpret("memcpy"), callable(&::memcpy)},
+                {mangleAndInterpret("memmove"), callable(&::memmove)},
+            })));
+            if (searchProcessSymbols) {
+                jitLib.addGenerator(cantFail(DynamicLibrarySearchGenerator::GetForCurrentProcess(
+                        dataLayout.getGlobalPrefix())));
             }
         }
 
@@ -65,36 +257,159 @@ namespace llvm::orc {
             }
         }
 
-        static Expected<std::unique_ptr<KaleidoscopeJIT>> Create() {
-            auto EPC = SelfExecutorProcessControl::Create();
+        static Expected<std::unique_ptr<KaleidoscopeJIT>> Create(const JITOptions &options = {}) {
+            std::unique_ptr<TaskDispatcher> dispatcher;
+            if (options.compileThreads > 0) {
+                dispatcher = std::make_unique<ThreadPoolTaskDispatcher>(options.compileThreads);
+            } else {
+                dispatcher = std::make_unique<InPlaceTaskDispatcher>();
+            }
+            auto EPC = SelfExecutorProcessControl::Create(nullptr, std::move(dispatcher));
             if (!EPC) {
                 return EPC.takeError();
             }
             auto ES = std::make_unique<ExecutionSession>(std::move(*EPC));
             JITTargetMachineBuilder JTMB(ES->getExecutorProcessControl().getTargetTriple());
+            if (options.targetHostCpu) {
+                auto hostJTMB = JITTargetMachineBuilder::detectHost();
+                if (!hostJTMB) {
+                    return hostJTMB.takeError();
+                }
+                JTMB = std::move(*hostJTMB);
+            }
+            JTMB.setCodeGenOptLevel(options.codeGenOptLevel);
 
             auto DL = JTMB.getDefaultDataLayoutForTarget();
             if (!DL) {
                 return DL.takeError();
             }
-            return std::make_unique<KaleidoscopeJIT>(std::move(ES), std::move(JTMB), std::move(*DL));
+
+            std::unique_ptr<LazyCallThroughManager> LCTM;
+            if (options.lazyCompilation || options.memoryLimit > 0 || options.profileWarmupCalls > 0) {
+                auto localLCTM = createLocalLazyCallThroughManager(
+                        JTMB.getTargetTriple(), *ES, ExecutorAddr::fromPtr(&handleLazyCallThroughError));
+                if (!localLCTM) {
+                    return localLCTM.takeError();
+                }
+                LCTM = std::move(*localLCTM);
+            }
+
+            std::unique_ptr<PersistentObjectCache> objectCache;
+            if (!options.objectCacheDir.empty()) {
+                if (const auto EC = sys::fs::create_directories(options.objectCacheDir)) {
+                    return errorCodeToError(EC);
+                }
+                // The IR is part of the key as well, so IR optimization settings need no entry here.
+                const auto targetKey = JTMB.getTargetTriple().str() + ";" + JTMB.getCPU() + ";"
+                                       + JTMB.getFeatures().getString() + ";"
+                                       + std::to_string(static_cast<int>(options.codeGenOptLevel));
+                objectCache = std::make_unique<PersistentObjectCache>(options.objectCacheDir, targetKey);
+            }
+
+            std::unique_ptr<SlabMemoryMapper> memoryMapper;
+            if (options.jitLink || options.memoryLimit > 0) {
+                auto slabMemoryMapper = SlabMemoryMapper::Create(options.slabSize, options.hugePages);
+                if (!slabMemoryMapper) {
+                    return slabMemoryMapper.takeError();
+                }
+                memoryMapper = std::move(*slabMemoryMapper);
+            }
+            return std::make_unique<KaleidoscopeJIT>(std::move(ES), std::move(JTMB), std::move(*DL), options.optimizeIR,
+                                                     std::move(LCTM), std::move(objectCache), std::move(memoryMapper),
+                                                     options.memoryLimit, options.profileWarmupCalls,
+                                                     options.searchProcessSymbols);
         }
 
         const DataLayout &getDataLayout() const { return dataLayout; }
 
+        const JITTargetMachineBuilder &getTargetMachineBuilder() const { return targetMachineBuilder; }
+
+        // Target machine matching the one used for JIT compilation, for target-aware IR optimizations.
+        Expected<std::unique_ptr<TargetMachine>> createTargetMachine() {
+            return targetMachineBuilder.createTargetMachine();
+        }
+
         JITDylib &getMainJITDylib() { return jitLib; }
 
+        // Functions defined in the bitcode are linked into the modules calling them. Must be called before modules
+        // are added.
+        void addBuiltinBitcode(std::string bitcode) {
+            builtinBitcodes.push_back(std::move(bitcode));
+        }
+
         Error addModule(ThreadSafeModule threadSafeModule,
                         ResourceTrackerSP resTracker) {
             if (resTracker == nullptr) {
                 resTracker = jitLib.getDefaultResourceTracker();
             }
-            return compileLayer.add(resTracker, std::move(threadSafeModule));
+            return optimizeLayer.add(resTracker, std::move(threadSafeModule));
+        }
+
+        // Same as addModule() unless lazy compilation, the memory limit or profiling is enabled. The latter two track
+        // every function on its own and ignore resTracker.
+        Error addLazyModule(ThreadSafeModule threadSafeModule,
+                            ResourceTrackerSP resTracker) {
+            if (evictionManager != nullptr) {
+                return evictionManager->addModule(std::move(threadSafeModule));
+            }
+            if (profileGuidedOptimizer != nullptr) {
+                return profileGuidedOptimizer->addModule(std::move(threadSafeModule));
+            }
+            if (compileOnDemandLayer == nullptr) {
+                return addModule(std::move(threadSafeModule), std::move(resTracker));
+            }
+            if (resTracker == nullptr) {
+                resTracker = jitLib.getDefaultResourceTracker();
+            }
+            return compileOnDemandLayer->add(resTracker, std::move(threadSafeModule));
         }
 
         Expected<ExecutorSymbolDef> lookup(const StringRef name) {
             return executionSession->lookup({&jitLib}, mangleAndInterpret(name.str()));
         }
+
+        // Starts materializing the symbol without waiting for it. With compile threads it is optimized and compiled
+        // in the background; a later lookup() waits only if the symbol isn't ready yet.
+        void speculate(const StringRef name) {
+            executionSession->lookup(
+                    LookupKind::Static, makeJITDylibSearchOrder(&jitLib),
+                    SymbolLookupSet(mangleAndInterpret(name.str())), SymbolState::Ready,
+                    [this](Expected<SymbolMap> result) {
+                        if (!result) {
+                            executionSession->reportError(result.takeError());
+                        }
+                    },
+                    NoDependenciesToRegister);
+        }
+
+        // Persistent object cache, or nullptr when it is disabled.
+        const PersistentObjectCache *getObjectCache() const { return objectCache.get(); }
+
+        // Brings the linked code back under the memory limit, see FunctionEvictionManager::evictColdFunctions().
+        Error evictColdFunctions() {
+            return evictionManager != nullptr ? evictionManager->evictColdFunctions() : Error::success();
+        }
+
+        // Eviction bookkeeping, or nullptr without a memory limit.
+        const FunctionEvictionManager *getEvictionManager() const { return evictionManager.get(); }
+
+        // Recompiles the functions which finished their warm-up, see ProfileGuidedOptimizer::reoptimizeHotFunctions().
+        Error reoptimizeHotFunctions() {
+            return profileGuidedOptimizer != nullptr ? profileGuidedOptimizer->reoptimizeHotFunctions()
+                                                     : Error::success();
+        }
+
+        // Profiling bookkeeping, or nullptr when profiling is disabled.
+        const ProfileGuidedOptimizer *getProfileGuidedOptimizer() const { return profileGuidedOptimizer.get(); }
+
+        // Slabs of the JITLink memory manager, or nullptr when objects are linked with RuntimeDyld.
+        const SlabMemoryMapper *getMemoryMapper() const { return memoryMapper; }
+
+        // Time spent in IR optimization and codegen by all compile threads.
+        std::chrono::nanoseconds getCompileTime() {
+            return std::chrono::nanoseconds(optimizeNanoseconds.load())
+                   + static_cast<CachedIRCompiler &>(compileLayer.getCompiler()).getCompileTime();
+        }
     };
 
 }  // namespace llvm::orc
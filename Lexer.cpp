@@ -107,6 +107,10 @@ TokenType Lexer::readNextToken(const bool inExpression) {
         currentToken = TokenType::LeftCurlyBracketToken;
     } else if (lastChar == '}') {
         currentToken = TokenType::RightCurlyBracketToken;
+    } else if (lastChar == '[') {
+        currentToken = TokenType::LeftSquareBracketToken;
+    } else if (lastChar == ']') {
+        currentToken = TokenType::RightSquareBracketToken;
     } else if (lastChar == ',') {
         currentToken = TokenType::CommaToken;
     } else if (lastChar == '=') {
@@ -154,6 +158,8 @@ TokenType Lexer::readNextToken(const bool inExpression) {
                 currentToken = TokenType::ElseToken;
             } else if (identifier == "for") {
                 currentToken = TokenType::ForLoopToken;
+            } else if (identifier == "parfor") {
+                currentToken = TokenType::ParallelForLoopToken;
             } else {
                 currentToken = TokenType::IdentifierToken;
             }
@@ -178,6 +184,10 @@ std::string Lexer::getNumberValue() const {
     return numberValue;
 }
 
+bool Lexer::isIntegerNumber() const {
+    return numberValue.find('.') == std::string::npos;
+}
+
 bool Lexer::isArithmeticOp(const TokenType token) {
     return token == TokenType::PlusToken
            || token == TokenType::MinusToken
@@ -18,12 +18,15 @@ enum class TokenType : std::uint8_t {
     IfToken,
     ElseToken,
     ForLoopToken,
+    ParallelForLoopToken,
     IncrementOperatorToken,
     DecrementOperatorToken,
     LeftParenthesisToken,
     RightParenthesisToken,
     LeftCurlyBracketToken,
     RightCurlyBracketToken,
+    LeftSquareBracketToken,
+    RightSquareBracketToken,
     LeftAngleBracketToken,
     RightAngleBracketToken,
     CommaToken,
@@ -49,6 +52,8 @@ public:
 
     [[nodiscard]] std::string getNumberValue() const;
 
+    [[nodiscard]] bool isIntegerNumber() const;
+
     [[nodiscard]] static bool isArithmeticOp(TokenType token);
 
 private:
@@ -3,10 +3,14 @@
 //
 
 #include "NodePrinter.h"
+#include "ast/ArrayAccessNode.h"
+#include "ast/ArrayAssignmentStatement.h"
 #include "ast/BinOpNode.h"
 #include "ast/CallFunctionNode.h"
+#include "ast/ForLoopNode.h"
 #include "ast/FunctionNode.h"
 #include "ast/NumberNode.h"
+#include "ast/ReductionNode.h"
 #include "ast/UnaryOpNode.h"
 #include "ast/VariableAccessNode.h"
 #include "ast/VariableDefinitionStatement.h"
@@ -82,9 +86,21 @@ void NodePrinter::visit(const IfStatement *node) {
 }
 
 void NodePrinter::visit(const ForLoopNode *node) {
-    ostream << "ForLoop";
+    ostream << (node->parallel ? "ParallelForLoop" : "ForLoop");
 }
 
 void NodePrinter::visit(const UnaryOpNode *node) {
     ostream << "UnaryOp: name=" << node->operatorType;
 }
+
+void NodePrinter::visit(const ArrayAccessNode *node) {
+    ostream << "ArrayAccess: name=" << node->name;
+}
+
+void NodePrinter::visit(const ArrayAssignmentStatement *node) {
+    ostream << "ArrayAssignment: array=" << node->name;
+}
+
+void NodePrinter::visit(const ReductionNode *node) {
+    ostream << "Reduction: var=" << node->init->name << (node->parallel ? ", parallel" : "");
+}
@@ -32,6 +32,12 @@ public:
 
     void visit(const UnaryOpNode *node) override;
 
+    void visit(const ArrayAccessNode *node) override;
+
+    void visit(const ArrayAssignmentStatement *node) override;
+
+    void visit(const ReductionNode *node) override;
+
 private:
     std::ostream &ostream;
 };
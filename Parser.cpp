@@ -70,7 +70,8 @@ std::unique_ptr<BaseNode> Parser::parseIdent() {
 }
 
 std::unique_ptr<NumberNode> Parser::parseNumberExpr() const {
-    auto number = std::make_unique<NumberNode>(strtod(lexer->getNumberValue().c_str(), nullptr));
+    auto number = std::make_unique<NumberNode>(strtod(lexer->getNumberValue().c_str(), nullptr),
+                                               lexer->isIntegerNumber());
     return number;
 }
 
@@ -0,0 +1,434 @@
+#include "ScriptParser.h"
+
+#include <cstdlib>
+#include <optional>
+#include <tuple>
+
+#include "ast/ArrayAccessNode.h"
+#include "ast/ArrayAssignmentStatement.h"
+#include "ast/BinOpNode.h"
+#include "ast/CallFunctionNode.h"
+#include "ast/ForLoopNode.h"
+#include "ast/IfStatement.h"
+#include "ast/NumberNode.h"
+#include "ast/ReductionNode.h"
+#include "ast/UnaryOpNode.h"
+#include "ast/VariableAccessNode.h"
+#include "ast/VariableDefinitionStatement.h"
+
+namespace {
+    std::tuple<std::unique_ptr<ExpressionNode>, std::unique_ptr<BaseNode> > toExpr(std::unique_ptr<BaseNode> node) {
+        if (dynamic_cast<ExpressionNode *>(node.get()) != nullptr) {
+            return {std::unique_ptr<ExpressionNode>(dynamic_cast<ExpressionNode *>(node.release())), nullptr};
+        }
+        return {nullptr, std::move(node)};
+    }
+
+    std::tuple<std::unique_ptr<StatementNode>, std::unique_ptr<BaseNode> >
+    toStatement(std::unique_ptr<BaseNode> node) {
+        if (dynamic_cast<StatementNode *>(node.get()) != nullptr) {
+            return {std::unique_ptr<StatementNode>(dynamic_cast<StatementNode *>(node.release())), nullptr};
+        }
+        return {nullptr, std::move(node)};
+    }
+
+    std::unique_ptr<ExpressionNode> parseNumberExpr(const std::unique_ptr<Lexer> &lexer,
+                                                    const bool inExpression = false) {
+        auto number = std::make_unique<NumberNode>(strtod(lexer->getNumberValue().c_str(), nullptr),
+                                                   lexer->isIntegerNumber());
+        lexer->readNextToken(inExpression);
+        return number;
+    }
+
+    std::unique_ptr<ExpressionNode> parseParentheses(const std::unique_ptr<Lexer> &lexer) {
+        if (lexer->getCurrentToken() != TokenType::LeftParenthesisToken) {
+            return nullptr;
+        }
+        lexer->readNextToken(); // eat TokenType::LeftParenthesis
+        auto expr = parseAstNodeItem(lexer);
+        if (lexer->getCurrentToken() != TokenType::RightParenthesisToken) {
+            return nullptr;
+        }
+        lexer->readNextToken(); // eat TokenType::RightParenthesis
+        return std::get<0>(toExpr(std::move(expr)));
+    }
+
+    std::list<std::unique_ptr<BaseNode> > parseCurlyBrackets(const std::unique_ptr<Lexer> &lexer) {
+        std::list<std::unique_ptr<BaseNode> > expressions;
+        while (lexer->getCurrentToken() != TokenType::RightCurlyBracketToken) {
+            auto node = parseAstNodeItem(lexer);
+            if (node == nullptr) {
+                break;
+            }
+            expressions.push_back(std::move(node));
+            if (lexer->getCurrentToken() == TokenType::EosToken) {
+                lexer->readNextToken(); // eat ';'
+            }
+        }
+        return expressions;
+    }
+
+    std::unique_ptr<StatementNode> parseIfExpression(const std::unique_ptr<Lexer> &lexer) {
+        lexer->readNextToken();
+        if (lexer->getCurrentToken() != TokenType::LeftParenthesisToken) {
+            return nullptr;
+        }
+        auto cond = parseParentheses(lexer);
+        if (lexer->getCurrentToken() != TokenType::LeftCurlyBracketToken) {
+            return nullptr;
+        }
+        lexer->readNextToken();
+        std::list<std::unique_ptr<BaseNode> > thenBranch = parseCurlyBrackets(lexer);
+        lexer->readNextToken();
+        std::optional<std::list<std::unique_ptr<BaseNode> > > elseBranch;
+        if (lexer->getCurrentToken() == TokenType::ElseToken) {
+            lexer->readNextToken();
+            if (lexer->getCurrentToken() != TokenType::LeftCurlyBracketToken) {
+                return nullptr;
+            }
+            lexer->readNextToken();
+            elseBranch = parseCurlyBrackets(lexer);
+            lexer->readNextToken(); // eat '}'
+        }
+        return std::make_unique<IfStatement>(std::move(cond), std::move(thenBranch), std::move(elseBranch));
+    }
+
+    // for (i = a, i < b, ++i) { ... }, or parfor (i = a, i < b) { ... }, which steps by one.
+    std::unique_ptr<StatementNode> parseForLoopExpression(const std::unique_ptr<Lexer> &lexer, const bool parallel) {
+        lexer->readNextToken();
+        if (lexer->getCurrentToken() != TokenType::LeftParenthesisToken) {
+            return nullptr;
+        }
+        lexer->readNextToken();
+        auto loopInit = parseIdentifier(lexer);
+        if (loopInit == nullptr) {
+            return nullptr;
+        }
+        lexer->readNextToken(true);
+        auto loopFinish = parseAstNodeItem(lexer);
+        if (loopFinish == nullptr) {
+            return nullptr;
+        }
+        std::unique_ptr<BaseNode> loopNext;
+        if (!parallel) {
+            lexer->readNextToken(true);
+            loopNext = parseAstNodeItem(lexer);
+            if (loopNext == nullptr) {
+                return nullptr;
+            }
+        } else if (lexer->getCurrentToken() != TokenType::RightParenthesisToken) {
+            return nullptr;
+        }
+        lexer->readNextToken();
+        if (lexer->getCurrentToken() != TokenType::LeftCurlyBracketToken) {
+            return nullptr;
+        }
+        lexer->readNextToken();
+        auto loopBody = parseCurlyBrackets(lexer);
+        lexer->readNextToken(); // eat '}'
+
+        auto forLoopExpr = std::make_unique<ForLoopNode>(std::get<0>(toStatement(std::move(loopInit))),
+                                                         std::get<0>(toExpr(std::move(loopNext))),
+                                                         std::get<0>(toExpr(std::move(loopFinish))),
+                                                         std::move(loopBody),
+                                                         parallel);
+        return forLoopExpr;
+    }
+
+    struct Reduction {
+        ReductionNode::Kind kind;
+        bool parallel;
+    };
+
+    // The reductions are called like functions whose first argument defines the index, so the names stay free for
+    // variables and defs, e.g. the min/max builtins.
+    std::optional<Reduction> reductionOf(const std::string &name) {
+        const bool parallel = name.starts_with("par");
+        const auto kind = parallel ? name.substr(3) : name;
+        if (kind == "sum") {
+            return Reduction{ReductionNode::Kind::Sum, parallel};
+        }
+        if (kind == "product") {
+            return Reduction{ReductionNode::Kind::Product, parallel};
+        }
+        if (kind == "min") {
+            return Reduction{ReductionNode::Kind::Min, parallel};
+        }
+        if (kind == "max") {
+            return Reduction{ReductionNode::Kind::Max, parallel};
+        }
+        return std::nullopt;
+    }
+
+    // sum(i = a, b) { ... } after the index definition; see ReductionNode.
+    std::unique_ptr<ExpressionNode> parseReduction(const std::unique_ptr<Lexer> &lexer,
+                                                   const Reduction reduction,
+                                                   std::unique_ptr<VariableDefinitionStatement> init) {
+        if (lexer->getCurrentToken() != TokenType::CommaToken) {
+            return nullptr;
+        }
+        lexer->readNextToken(); // eat ','
+        auto end = parseAstNodeItem(lexer);
+        if (end == nullptr || lexer->getCurrentToken() != TokenType::RightParenthesisToken) {
+            return nullptr;
+        }
+        lexer->readNextToken(); // eat ')'
+        if (lexer->getCurrentToken() != TokenType::LeftCurlyBracketToken) {
+            return nullptr;
+        }
+        lexer->readNextToken(); // eat '{'
+        auto body = parseCurlyBrackets(lexer);
+        if (body.empty() || lexer->getCurrentToken() != TokenType::RightCurlyBracketToken) {
+            return nullptr;
+        }
+        lexer->readNextToken(); // eat '}'
+        return std::make_unique<ReductionNode>(reduction.kind,
+                                               std::move(init),
+                                               std::get<0>(toExpr(std::move(end))),
+                                               std::move(body),
+                                               reduction.parallel);
+    }
+
+    std::unique_ptr<ExpressionNode> parseUnaryExpression(const std::unique_ptr<Lexer> &lexer) {
+        const auto operatorType = lexer->getCurrentToken();
+        lexer->readNextToken(true);
+        auto expr = parseExpr(lexer, true);
+        return std::make_unique<UnaryOpNode>(operatorType,
+                                             std::get<0>(toExpr(std::move(expr))));
+    }
+
+    std::unique_ptr<StatementNode> parseStatement(const std::unique_ptr<Lexer> &lexer) {
+        if (lexer->getCurrentToken() == TokenType::IfToken) {
+            return parseIfExpression(lexer);
+        }
+        if (lexer->getCurrentToken() == TokenType::ForLoopToken) {
+            return parseForLoopExpression(lexer, false);
+        }
+        if (lexer->getCurrentToken() == TokenType::ParallelForLoopToken) {
+            return parseForLoopExpression(lexer, true);
+        }
+        return nullptr;
+    }
+
+    int getBinOpPrecedence(const TokenType binOp) {
+        int binOpPrec = -1;
+        if (binOp == TokenType::PlusToken || binOp == TokenType::MinusToken) {
+            binOpPrec = 1;
+        } else if (binOp == TokenType::DivideToken || binOp == TokenType::MultiplyToken) {
+            binOpPrec = 2;
+        } else if (binOp == TokenType::LeftAngleBracketToken || binOp == TokenType::RightAngleBracketToken) {
+            binOpPrec = 0;
+        }
+        return binOpPrec;
+    }
+
+    std::unique_ptr<ExpressionNode> parseBinOp(const std::unique_ptr<Lexer> &lexer,
+                                               const int expPrec,
+                                               std::unique_ptr<ExpressionNode> lhs) {
+        while (true) {
+            const auto binOp = lexer->getCurrentToken();
+            const int curBinOpPrec = getBinOpPrecedence(binOp);
+            if (curBinOpPrec < expPrec) {
+                return lhs;
+            }
+
+            lexer->readNextToken(true); // read rhs
+            auto rhs = parseExpr(lexer, true);
+            if (rhs == nullptr) {
+                return nullptr;
+            }
+
+            const auto nextBinOp = lexer->getCurrentToken();
+            if (const int nextBinOpPrec = getBinOpPrecedence(nextBinOp); curBinOpPrec < nextBinOpPrec) {
+                if (rhs = parseBinOp(lexer, curBinOpPrec, std::get<0>(toExpr(std::move(rhs)))); rhs == nullptr) {
+                    return nullptr;
+                }
+            }
+
+            lhs = std::make_unique<BinOpNode>(binOp, std::move(lhs), std::get<0>(toExpr(std::move(rhs))));
+        }
+    }
+
+    std::unique_ptr<ProtoFunctionStatement> parseProto(const std::unique_ptr<Lexer> &lexer) {
+        const std::string name = lexer->getIdentifier();
+        lexer->readNextToken(); // eat callee
+        if (lexer->getCurrentToken() != TokenType::LeftParenthesisToken) {
+            return nullptr;
+        }
+        lexer->readNextToken(); // eat TokenType::LeftParenthesis
+        std::vector<std::string> args;
+        std::vector<bool> arrayArgs;
+        while (lexer->hasNextToken()) {
+            if (lexer->getCurrentToken() != TokenType::IdentifierToken) {
+                break;
+            }
+            args.push_back(lexer->getIdentifier());
+            lexer->readNextToken(); // eat arg
+            // An array arg is declared as a[].
+            arrayArgs.push_back(lexer->getCurrentToken() == TokenType::LeftSquareBracketToken);
+            if (arrayArgs.back()) {
+                if (lexer->readNextToken() != TokenType::RightSquareBracketToken) {
+                    return nullptr;
+                }
+                lexer->readNextToken(); // eat ']'
+            }
+            if (lexer->getCurrentToken() == TokenType::CommaToken) {
+                lexer->readNextToken(); // eat next arg
+            }
+        }
+        if (lexer->getCurrentToken() != TokenType::RightParenthesisToken) {
+            return nullptr;
+        }
+        lexer->readNextToken(); // eat TokenType::RightParenthesis
+        return std::make_unique<ProtoFunctionStatement>(name, args, false, arrayArgs);
+    }
+
+    // fast, fast(flag, ...) or strict after the args of a def, see ProtoFunctionStatement::fastMath.
+    bool parseFastMath(const std::unique_ptr<Lexer> &lexer, ProtoFunctionStatement &proto) {
+        const auto attribute = lexer->getIdentifier();
+        if (attribute != "fast" && attribute != "strict") {
+            return false;
+        }
+        lexer->readNextToken(); // eat attribute
+        FastMath fastMath;
+        if (attribute == "strict") {
+            proto.fastMath = fastMath;
+            return true;
+        }
+        if (lexer->getCurrentToken() != TokenType::LeftParenthesisToken) {
+            fastMath.set("fast");
+            proto.fastMath = fastMath;
+            return true;
+        }
+        lexer->readNextToken(); // eat '('
+        while (lexer->getCurrentToken() == TokenType::IdentifierToken) {
+            if (!fastMath.set(lexer->getIdentifier())) {
+                return false;
+            }
+            lexer->readNextToken(); // eat flag
+            if (lexer->getCurrentToken() == TokenType::CommaToken) {
+                lexer->readNextToken(); // eat ','
+            }
+        }
+        if (lexer->getCurrentToken() != TokenType::RightParenthesisToken) {
+            return false;
+        }
+        lexer->readNextToken(); // eat ')'
+        proto.fastMath = fastMath;
+        return true;
+    }
+} // namespace
+
+std::unique_ptr<BaseNode> parseIdentifier(const std::unique_ptr<Lexer> &lexer, const bool inExpression) {
+    const std::string name = lexer->getIdentifier();
+    lexer->readNextToken(inExpression); // eat identifier
+    if (lexer->getCurrentToken() == TokenType::EqualsToken) {
+        lexer->readNextToken(); // eat =
+        auto expr = parseAstNodeItem(lexer);
+        return std::make_unique<VariableDefinitionStatement>(name, std::get<0>(toExpr(std::move(expr))));
+    }
+    if (lexer->getCurrentToken() == TokenType::LeftSquareBracketToken) {
+        lexer->readNextToken(); // eat '['
+        auto index = parseAstNodeItem(lexer);
+        if (index == nullptr || lexer->getCurrentToken() != TokenType::RightSquareBracketToken) {
+            return nullptr;
+        }
+        lexer->readNextToken(inExpression); // eat ']'
+        if (lexer->getCurrentToken() == TokenType::EqualsToken) {
+            lexer->readNextToken(); // eat =
+            auto expr = parseAstNodeItem(lexer);
+            return std::make_unique<ArrayAssignmentStatement>(name,
+                                                              std::get<0>(toExpr(std::move(index))),
+                                                              std::get<0>(toExpr(std::move(expr))));
+        }
+        return std::make_unique<ArrayAccessNode>(name, std::get<0>(toExpr(std::move(index))));
+    }
+    if (lexer->getCurrentToken() != TokenType::LeftParenthesisToken) {
+        return std::make_unique<VariableAccessNode>(name);
+    }
+
+    std::vector<std::unique_ptr<ExpressionNode> > args;
+    lexer->readNextToken(); // eat TokenType::LeftParenthesis
+    while (true) {
+        if (auto arg = parseAstNodeItem(lexer)) {
+            const auto reduction = reductionOf(name);
+            if (args.empty() && reduction && dynamic_cast<VariableDefinitionStatement *>(arg.get()) != nullptr) {
+                return parseReduction(lexer, *reduction, std::unique_ptr<VariableDefinitionStatement>(
+                                          static_cast<VariableDefinitionStatement *>(arg.release())));
+            }
+            args.push_back(std::get<0>(toExpr(std::move(arg))));
+            if (lexer->getCurrentToken() == TokenType::CommaToken) {
+                lexer->readNextToken(); // eat ','
+            } else {
+                break;
+            }
+        } else {
+            break;
+        }
+    }
+    if (lexer->getCurrentToken() != TokenType::RightParenthesisToken) {
+        return nullptr;
+    }
+    lexer->readNextToken(); // eat TokenType::RightParenthesis
+    return std::make_unique<CallFunctionNode>(name, std::move(args));
+}
+
+std::unique_ptr<BaseNode> parseExpr(const std::unique_ptr<Lexer> &lexer, const bool inExpression) {
+    if (lexer->getCurrentToken() == TokenType::NumberToken) {
+        return parseNumberExpr(lexer, inExpression);
+    }
+    if (lexer->getCurrentToken() == TokenType::IdentifierToken) {
+        return parseIdentifier(lexer, inExpression);
+    }
+    if (lexer->getCurrentToken() == TokenType::IncrementOperatorToken
+        || lexer->getCurrentToken() == TokenType::DecrementOperatorToken) {
+        return parseUnaryExpression(lexer);
+    }
+    if (lexer->getCurrentToken() == TokenType::LeftParenthesisToken) {
+        return parseParentheses(lexer);
+    }
+    return nullptr;
+}
+
+std::unique_ptr<BaseNode> parseAstNodeItem(const std::unique_ptr<Lexer> &lexer) {
+    if (auto node = parseExpr(lexer, true)) {
+        auto [expr, srcNode] = toExpr(std::move(node));
+        if (expr) {
+            return parseBinOp(lexer, 0, std::move(expr));
+        }
+        return std::move(srcNode);
+    }
+    if (auto statement = parseStatement(lexer)) {
+        return statement;
+    }
+    return nullptr;
+}
+
+std::unique_ptr<FunctionNode> parseFunctionDefinition(const std::unique_ptr<Lexer> &lexer) {
+    lexer->readNextToken(); // eat def
+    auto proto = parseProto(lexer);
+    if (proto != nullptr && lexer->getCurrentToken() == TokenType::IdentifierToken && !parseFastMath(lexer, *proto)) {
+        return nullptr;
+    }
+    if (lexer->getCurrentToken() != TokenType::LeftCurlyBracketToken) {
+        return nullptr;
+    }
+    lexer->readNextToken();
+    std::list<std::unique_ptr<BaseNode> > body = parseCurlyBrackets(lexer);
+    return std::make_unique<FunctionNode>(std::move(proto), std::move(body));
+}
+
+std::unique_ptr<FunctionNode> parseTopLevelExpr(const std::unique_ptr<Lexer> &lexer,
+                                                const char *const functionName) {
+    std::list<std::unique_ptr<BaseNode> > body;
+    while (auto expr = parseAstNodeItem(lexer)) {
+        body.push_back(std::move(expr));
+        if (lexer->getCurrentToken() == TokenType::EosToken) {
+            lexer->readNextToken(); // eat ';'
+        }
+    }
+    auto proto = std::make_unique<ProtoFunctionStatement>(
+        functionName, std::vector<std::string>());
+    proto->topLevel = true;
+    return std::make_unique<FunctionNode>(std::move(proto), std::move(body));
+}
@@ -0,0 +1,28 @@
+#ifndef SCRIPTPARSER_H
+#define SCRIPTPARSER_H
+
+#include <list>
+#include <memory>
+
+#include "Lexer.h"
+#include "ast/BaseNode.h"
+#include "ast/FunctionNode.h"
+#include "ast/ProtoFunctionStatement.h"
+
+// Recursive descent parser of scripts: defs, top-level expressions, if and for statements. Every function expects
+// the lexer at the first token of what it parses and returns nullptr on a syntax error.
+
+std::unique_ptr<BaseNode> parseAstNodeItem(const std::unique_ptr<Lexer> &lexer);
+
+std::unique_ptr<BaseNode> parseExpr(const std::unique_ptr<Lexer> &lexer, bool inExpression = false);
+
+// A variable access, an assignment or a call.
+std::unique_ptr<BaseNode> parseIdentifier(const std::unique_ptr<Lexer> &lexer, bool inExpression = false);
+
+// Expects the lexer at `def` and leaves it at the closing '}'.
+std::unique_ptr<FunctionNode> parseFunctionDefinition(const std::unique_ptr<Lexer> &lexer);
+
+// Wraps the expressions up to the next def or the end of the script into a function without arguments.
+std::unique_ptr<FunctionNode> parseTopLevelExpr(const std::unique_ptr<Lexer> &lexer, const char *functionName);
+
+#endif //SCRIPTPARSER_H
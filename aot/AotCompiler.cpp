@@ -0,0 +1,180 @@
+#include "AotCompiler.h"
+
+#include <algorithm>
+#include <cctype>
+
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/TargetParser/Host.h"
+
+#include "ir/IRCodegen.h"
+#include "ir/IROptimizer.h"
+#include "ir/PurityAnalysis.h"
+#include "runtime/ParallelFor.h"
+
+namespace {
+    llvm::Expected<std::unique_ptr<llvm::TargetMachine> > createTargetMachine(const AotOptions &options) {
+        llvm::orc::JITTargetMachineBuilder targetMachineBuilder(llvm::Triple(llvm::sys::getProcessTriple()));
+        if (options.targetHostCpu) {
+            auto hostTargetMachineBuilder = llvm::orc::JITTargetMachineBuilder::detectHost();
+            if (!hostTargetMachineBuilder) {
+                return hostTargetMachineBuilder.takeError();
+            }
+            targetMachineBuilder = std::move(*hostTargetMachineBuilder);
+        }
+        // Position independent code links into executables and shared libraries alike.
+        targetMachineBuilder.setRelocationModel(llvm::Reloc::PIC_);
+        targetMachineBuilder.setCodeGenOptLevel(options.codeGenOptLevel);
+        return targetMachineBuilder.createTargetMachine();
+    }
+
+    llvm::Error emitObjectFile(llvm::Module &module, llvm::TargetMachine &targetMachine, const std::string &path) {
+        std::error_code errorCode;
+        llvm::raw_fd_ostream os(path, errorCode, llvm::sys::fs::OF_None);
+        if (errorCode) {
+            return llvm::createFileError(path, errorCode);
+        }
+        llvm::legacy::PassManager passManager;
+        if (targetMachine.addPassesToEmitFile(passManager, os, nullptr, llvm::CodeGenFileType::ObjectFile)) {
+            return llvm::createStringError(llvm::inconvertibleErrorCode(), "the target can't emit object files");
+        }
+        passManager.run(module);
+        os.close();
+        if (os.has_error()) {
+            return llvm::createFileError(path, os.error());
+        }
+        return llvm::Error::success();
+    }
+
+    llvm::Error linkSharedLibrary(const std::string &objectPath, const std::string &path) {
+        const auto compiler = llvm::sys::findProgramByName("cc");
+        if (!compiler) {
+            return llvm::createStringError(compiler.getError(), "cc is required to link a shared library");
+        }
+        const llvm::StringRef args[] = {*compiler, "-shared", "-o", path, objectPath};
+        std::string errorMessage;
+        const auto exitCode = llvm::sys::ExecuteAndWait(*compiler, args, std::nullopt, {}, 0, 0, &errorMessage);
+        if (exitCode != 0) {
+            return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                           "linking " + path + " failed: " + errorMessage);
+        }
+        return llvm::Error::success();
+    }
+
+    void declare(llvm::raw_ostream &os, const llvm::Function &function) {
+        os << "double " << function.getName() << "(";
+        for (const auto &arg: function.args()) {
+            os << (arg.getArgNo() == 0 ? "" : ", ");
+            // An array is passed as a pointer to its first element, followed by its length.
+            if (arg.getType()->isPointerTy()) {
+                os << (arg.onlyReadsMemory() ? "const double *" : "double *") << arg.getName();
+            } else if (arg.getType()->isIntegerTy()) {
+                std::string name(arg.getName());
+                std::replace(name.begin(), name.end(), '.', '_');
+                os << "size_t " << name;
+            } else {
+                os << "double " << arg.getName();
+            }
+        }
+        os << (function.arg_empty() ? "void" : "") << ");\n";
+    }
+
+    llvm::Error writeHeader(const llvm::Module &module, const std::string &path) {
+        std::error_code errorCode;
+        llvm::raw_fd_ostream os(path, errorCode, llvm::sys::fs::OF_Text);
+        if (errorCode) {
+            return llvm::createFileError(path, errorCode);
+        }
+        std::string guard(llvm::sys::path::filename(path));
+        for (auto &c: guard) {
+            c = std::isalnum(static_cast<unsigned char>(c)) ? static_cast<char>(std::toupper(c)) : '_';
+        }
+
+        os << "// Generated by simple_ast_parser --aot, do not edit.\n\n"
+                << "#ifndef " << guard << "\n#define " << guard << "\n\n"
+                << "#include <stddef.h>\n\n"
+                << "#ifdef __cplusplus\nextern \"C\" {\n#endif\n\n";
+        for (const auto &function: module) {
+            if (!function.isDeclaration()) {
+                declare(os, function);
+            }
+        }
+        bool hasImports = false;
+        for (const auto &function: module) {
+            // The runtime, e.g. the pool running parfor loops, comes with the simple_ast_engine library.
+            if (function.isDeclaration() && !function.isIntrinsic() && !function.use_empty()
+                && function.getName() != parallelForSymbol) {
+                os << (hasImports ? "" : "\n// Provided by the host program.\n");
+                declare(os, function);
+                hasImports = true;
+            }
+        }
+        os << "\n#ifdef __cplusplus\n}\n#endif\n\n#endif // " << guard << "\n";
+        os.close();
+        if (os.has_error()) {
+            return llvm::createFileError(path, os.error());
+        }
+        return llvm::Error::success();
+    }
+} // namespace
+
+llvm::Error compileAheadOfTime(
+    const std::vector<const FunctionNode *> &functions,
+    std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > &functionProtos,
+    const AotOptions &options) {
+    auto targetMachine = createTargetMachine(options);
+    if (!targetMachine) {
+        return targetMachine.takeError();
+    }
+
+    const auto llvmContext = std::make_unique<llvm::LLVMContext>();
+    const auto llvmModule = std::make_unique<llvm::Module>(options.outputPath, *llvmContext);
+    llvmModule->setDataLayout((*targetMachine)->createDataLayout());
+    llvmModule->setTargetTriple((*targetMachine)->getTargetTriple().str());
+    const auto llvmIRBuilder = std::make_unique<llvm::IRBuilder<> >(*llvmContext);
+    std::unordered_map<std::string, llvm::Value *> namedValues;
+    for (const auto *const function: functions) {
+        functionProtos[function->proto->name] = std::make_unique<ProtoFunctionStatement>(function->proto->name,
+                                                                                        function->proto->args,
+                                                                                        false,
+                                                                                        function->proto->arrayArgs);
+        functionProtos[function->proto->name]->fastMath = function->proto->fastMath.value_or(options.fastMath);
+    }
+    inferPurity(functions, functionProtos);
+    for (const auto *const function: functions) {
+        if (generateIR(function, llvmContext, llvmIRBuilder, llvmModule, functionProtos, namedValues) == nullptr) {
+            return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                           "can't generate " + function->proto->name);
+        }
+    }
+    optimizeModule(*llvmModule, **targetMachine);
+
+    const auto sharedLibrary = llvm::sys::path::extension(options.outputPath) == ".so";
+    llvm::SmallString<128> objectPath(options.outputPath);
+    if (sharedLibrary) {
+        if (const auto errorCode = llvm::sys::fs::createTemporaryFile("simple_ast_parser", "o", objectPath)) {
+            return llvm::errorCodeToError(errorCode);
+        }
+    }
+    auto error = emitObjectFile(*llvmModule, **targetMachine, std::string(objectPath));
+    if (!error && sharedLibrary) {
+        error = linkSharedLibrary(std::string(objectPath), options.outputPath);
+    }
+    if (sharedLibrary) {
+        llvm::sys::fs::remove(objectPath);
+    }
+    if (error) {
+        return error;
+    }
+
+    llvm::SmallString<128> headerPath(options.outputPath);
+    llvm::sys::path::replace_extension(headerPath, "h");
+    return writeHeader(*llvmModule, std::string(headerPath));
+}
@@ -0,0 +1,35 @@
+#ifndef AOTCOMPILER_H
+#define AOTCOMPILER_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "llvm/Support/CodeGen.h"
+#include "llvm/Support/Error.h"
+
+#include "ast/FastMath.h"
+#include "ast/FunctionNode.h"
+
+struct AotOptions {
+    // A .so path produces a shared library, anything else a relocatable object file. The C header is written next to
+    // it, with the extension replaced by .h.
+    std::string outputPath;
+    // Generate code for the host CPU and all of its features; false targets the generic CPU of the triple, for
+    // outputs that run on other machines.
+    bool targetHostCpu = true;
+    llvm::CodeGenOptLevel codeGenOptLevel = llvm::CodeGenOptLevel::Default;
+    // Fast-math flags of the defs without a fast or strict attribute.
+    FastMath fastMath;
+};
+
+// Generates the functions into one module, optimizes it with the O2 pipeline and compiles it ahead of time.
+// Every def becomes an exported C function taking and returning doubles. Functions which are called but not defined,
+// such as print, must be provided by the program linking the output; the header declares them separately.
+llvm::Error compileAheadOfTime(
+    const std::vector<const FunctionNode *> &functions,
+    std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > &functionProtos,
+    const AotOptions &options);
+
+#endif //AOTCOMPILER_H
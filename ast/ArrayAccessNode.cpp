@@ -0,0 +1,14 @@
+#include "ArrayAccessNode.h"
+
+ArrayAccessNode::ArrayAccessNode(std::string name, std::unique_ptr<ExpressionNode> index)
+    : name(std::move(name)),
+      index(std::move(index)) {
+}
+
+std::string ArrayAccessNode::toString() const {
+    return "array access name=" + name + ", index=" + index->toString();
+}
+
+void ArrayAccessNode::visit(NodeVisitor *const visitor) const {
+    visitor->visit(this);
+}
@@ -0,0 +1,22 @@
+#ifndef ARRAYACCESSNODE_H
+#define ARRAYACCESSNODE_H
+
+#include <memory>
+#include <string>
+
+#include "BaseNode.h"
+
+// Reads a[index]. The index is truncated to an integer and must be below len(a).
+class ArrayAccessNode final : public ExpressionNode {
+public:
+  ArrayAccessNode(std::string name, std::unique_ptr<ExpressionNode> index);
+
+  [[nodiscard]] std::string toString() const override;
+
+  void visit(NodeVisitor *visitor) const override;
+
+  const std::string name;
+  const std::unique_ptr<ExpressionNode> index;
+};
+
+#endif //ARRAYACCESSNODE_H
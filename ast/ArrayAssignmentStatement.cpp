@@ -0,0 +1,17 @@
+#include "ArrayAssignmentStatement.h"
+
+ArrayAssignmentStatement::ArrayAssignmentStatement(std::string name,
+                                                   std::unique_ptr<ExpressionNode> index,
+                                                   std::unique_ptr<ExpressionNode> rvalue)
+    : name(std::move(name)),
+      index(std::move(index)),
+      rvalue(std::move(rvalue)) {
+}
+
+std::string ArrayAssignmentStatement::toString() const {
+    return "array assignment name=" + name + ", index=" + index->toString() + ", rvalue=" + rvalue->toString();
+}
+
+void ArrayAssignmentStatement::visit(NodeVisitor *const visitor) const {
+    visitor->visit(this);
+}
@@ -0,0 +1,25 @@
+#ifndef ARRAYASSIGNMENTSTATEMENT_H
+#define ARRAYASSIGNMENTSTATEMENT_H
+
+#include <memory>
+#include <string>
+
+#include "BaseNode.h"
+
+// Stores rvalue into a[index], writing through to the buffer of the host.
+class ArrayAssignmentStatement final : public StatementNode {
+public:
+  ArrayAssignmentStatement(std::string name,
+                           std::unique_ptr<ExpressionNode> index,
+                           std::unique_ptr<ExpressionNode> rvalue);
+
+  [[nodiscard]] std::string toString() const override;
+
+  void visit(NodeVisitor *visitor) const override;
+
+  const std::string name;
+  const std::unique_ptr<ExpressionNode> index;
+  const std::unique_ptr<ExpressionNode> rvalue;
+};
+
+#endif //ARRAYASSIGNMENTSTATEMENT_H
@@ -9,6 +9,9 @@
 #include <string>
 
 class UnaryOpNode;
+class ArrayAccessNode;
+class ArrayAssignmentStatement;
+class ReductionNode;
 class ForLoopNode;
 class IfStatement;
 class CallFunctionNode;
@@ -42,6 +45,12 @@ public:
     virtual void visit(const ForLoopNode *node) = 0;
 
     virtual void visit(const UnaryOpNode *node) = 0;
+
+    virtual void visit(const ArrayAccessNode *node) = 0;
+
+    virtual void visit(const ArrayAssignmentStatement *node) = 0;
+
+    virtual void visit(const ReductionNode *node) = 0;
 };
 
 class BaseNode {
@@ -0,0 +1,22 @@
+#include "FastMath.h"
+
+bool FastMath::set(const std::string &flag) {
+    if (flag == "fast") {
+        reassoc = contract = noNaNs = noInfs = noSignedZeros = allowReciprocal = true;
+    } else if (flag == "reassoc") {
+        reassoc = true;
+    } else if (flag == "contract") {
+        contract = true;
+    } else if (flag == "nnan") {
+        noNaNs = true;
+    } else if (flag == "ninf") {
+        noInfs = true;
+    } else if (flag == "nsz") {
+        noSignedZeros = true;
+    } else if (flag == "arcp") {
+        allowReciprocal = true;
+    } else {
+        return false;
+    }
+    return true;
+}
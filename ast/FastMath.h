@@ -0,0 +1,25 @@
+#ifndef FASTMATH_H
+#define FASTMATH_H
+
+#include <string>
+
+// Fast-math flags of the floating-point code of a def, named like in LLVM IR. All clear is strict IEEE semantics.
+struct FastMath {
+  // Operations may be reassociated, e.g. to vectorize a sum with several accumulators.
+  bool reassoc = false;
+  // a * b + c may be fused into an fma.
+  bool contract = false;
+  // Args and results are assumed not to be NaN (nnan) or infinite (ninf), the sign of zero not to matter (nsz).
+  bool noNaNs = false;
+  bool noInfs = false;
+  bool noSignedZeros = false;
+  // x / y may become x * (1 / y) (arcp).
+  bool allowReciprocal = false;
+
+  // Sets reassoc, contract, nnan, ninf, nsz or arcp, or all of them for fast; false for other names.
+  bool set(const std::string &flag);
+
+  bool operator==(const FastMath &) const = default;
+};
+
+#endif //FASTMATH_H
@@ -3,14 +3,16 @@
 ForLoopNode::ForLoopNode(std::unique_ptr<StatementNode> initExpr,
                          std::unique_ptr<ExpressionNode> nextExpr,
                          std::unique_ptr<ExpressionNode> endExpr,
-                         std::list<std::unique_ptr<BaseNode> > body) : init(std::move(initExpr)),
-                                                                       next(std::move(nextExpr)),
-                                                                       conditional(std::move(endExpr)),
-                                                                       body(std::move(body)) {
+                         std::list<std::unique_ptr<BaseNode> > body,
+                         const bool parallel) : init(std::move(initExpr)),
+                                                next(std::move(nextExpr)),
+                                                conditional(std::move(endExpr)),
+                                                body(std::move(body)),
+                                                parallel(parallel) {
 }
 
 std::string ForLoopNode::toString() const {
-    return "for loop";
+    return parallel ? "parallel for loop" : "for loop";
 }
 
 void ForLoopNode::visit(NodeVisitor *visitor) const {
@@ -15,7 +15,8 @@ public:
   ForLoopNode(std::unique_ptr<StatementNode> initExpr,
               std::unique_ptr<ExpressionNode> nextExpr,
               std::unique_ptr<ExpressionNode> endExpr,
-              std::list<std::unique_ptr<BaseNode>> body);
+              std::list<std::unique_ptr<BaseNode>> body,
+              bool parallel = false);
 
   [[nodiscard]] std::string toString() const override;
 
@@ -25,6 +26,9 @@ public:
   const std::unique_ptr<ExpressionNode> next;
   const std::unique_ptr<ExpressionNode> conditional;
   const std::list<std::unique_ptr<BaseNode>> body;
+  // parfor (i = a, i < b) { ... }: the iterations run concurrently, each sees the values the locals of the
+  // enclosing function had when the loop started and may not assign them. The loop evaluates to 0.
+  const bool parallel;
 };
 
 #endif //FORLOOPSTATEMENT_H
@@ -1,6 +1,9 @@
 #include "NumberNode.h"
 
-NumberNode::NumberNode(const double v) : value(v) {
+#include <cmath>
+
+NumberNode::NumberNode(const double v, const bool isInteger) : value(v),
+                                                               isInteger(isInteger && std::abs(v) < 0x1p63) {
 }
 
 std::string NumberNode::toString() const {
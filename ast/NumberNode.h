@@ -9,13 +9,16 @@
 
 class NumberNode final : public ExpressionNode {
 public:
-  explicit NumberNode(double v);
+  explicit NumberNode(double v, bool isInteger = false);
 
   [[nodiscard]] std::string toString() const override;
 
   void visit(NodeVisitor *visitor) const override;
 
-  double value;
+  const double value;
+  // The literal was written without a fractional part and fits into a 64-bit integer. Larger literals are doubles,
+  // since converting them to an integer is undefined behaviour.
+  const bool isInteger;
 };
 
 #endif //NUMBERAST_H
@@ -1,8 +1,16 @@
 #include "ProtoFunctionStatement.h"
 
-ProtoFunctionStatement::ProtoFunctionStatement(std::string name, std::vector<std::string> args)
+#include <algorithm>
+
+ProtoFunctionStatement::ProtoFunctionStatement(std::string name,
+                                               std::vector<std::string> args,
+                                               const bool pure,
+                                               std::vector<bool> arrayArgs)
     : name(std::move(name)),
-      args(std::move(args)) {
+      args(std::move(args)),
+      pure(pure),
+      arrayArgs(std::move(arrayArgs)) {
+    this->arrayArgs.resize(this->args.size(), false);
 }
 
 std::string ProtoFunctionStatement::toString() const {
@@ -12,3 +20,11 @@ std::string ProtoFunctionStatement::toString() const {
 void ProtoFunctionStatement::visit(NodeVisitor *const visitor) const {
     visitor->visit(this);
 }
+
+bool ProtoFunctionStatement::isArray(const std::size_t arg) const {
+    return arrayArgs[arg];
+}
+
+std::size_t ProtoFunctionStatement::nativeArity() const {
+    return args.size() + std::count(arrayArgs.begin(), arrayArgs.end(), true);
+}
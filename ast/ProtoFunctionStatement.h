@@ -4,20 +4,43 @@
 
 #ifndef PROTOFUNCTIONAST_H
 #define PROTOFUNCTIONAST_H
+#include <optional>
 #include <vector>
 
 #include "BaseNode.h"
+#include "FastMath.h"
 
 class ProtoFunctionStatement final : public StatementNode {
 public:
-  ProtoFunctionStatement(std::string name, std::vector<std::string> args);
+  ProtoFunctionStatement(std::string name,
+                         std::vector<std::string> args,
+                         bool pure = false,
+                         std::vector<bool> arrayArgs = {});
 
   [[nodiscard]] std::string toString() const override;
 
   void visit(NodeVisitor *visitor) const override;
 
+  [[nodiscard]] bool isArray(std::size_t arg) const;
+
+  // Number of native parameters: an array arg is passed as a pointer to its first element and a length.
+  [[nodiscard]] std::size_t nativeArity() const;
+
   std::string name;
   std::vector<std::string> args;
+  // Neither reads nor writes memory visible to the caller.
+  bool pure;
+  // Pure, always returns and never throws, so unused calls may be removed.
+  bool willReturn = false;
+  // Returns and is free of undefined behaviour for any args, so calls may run even where the caller wouldn't run them.
+  bool speculatable = false;
+  // One flag per arg, set for array args. Array args are bound to buffers of the host without copying.
+  std::vector<bool> arrayArgs;
+  // Set by def f(x) fast(reassoc, contract) { ... }, fast alone sets every flag and strict none. Defs without either
+  // use the flags of the engine.
+  std::optional<FastMath> fastMath;
+  // A top-level expression rather than a def: its assignments write the globals of the script, see GlobalVariables.h.
+  bool topLevel = false;
 };
 
 #endif //PROTOFUNCTIONAST_H
@@ -0,0 +1,21 @@
+#include "ReductionNode.h"
+
+ReductionNode::ReductionNode(const Kind kind,
+                             std::unique_ptr<VariableDefinitionStatement> init,
+                             std::unique_ptr<ExpressionNode> end,
+                             std::list<std::unique_ptr<BaseNode> > body,
+                             const bool parallel)
+    : kind(kind),
+      init(std::move(init)),
+      end(std::move(end)),
+      body(std::move(body)),
+      parallel(parallel) {
+}
+
+std::string ReductionNode::toString() const {
+    return parallel ? "parallel reduction" : "reduction";
+}
+
+void ReductionNode::visit(NodeVisitor *const visitor) const {
+    visitor->visit(this);
+}
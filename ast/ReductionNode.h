@@ -0,0 +1,46 @@
+#ifndef REDUCTIONNODE_H
+#define REDUCTIONNODE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+
+#include "BaseNode.h"
+#include "VariableDefinitionStatement.h"
+
+// sum(i = a, b) { ... } combines the values of the body for every i in [a, b), b computed once. An empty range
+// gives the identity: 0 for sum, 1 for product, +inf for min and -inf for max. The values of the body are converted
+// to doubles and reduced as such, so integer bodies are exact only while every partial result stays below 2^53 in
+// magnitude. The reduction trades the sequential order for speed:
+//   sum, product: the partial results are combined in any order (reassoc), so rounding may differ from a
+//                 left-to-right loop by a few ulp;
+//   min, max:     NaNs and the sign of zero are assumed not to matter (nnan, nsz).
+// These flags come on top of the fast-math flags of the def, which the body gets like the rest of the def. parsum,
+// parproduct, parmin and parmax split the range across the cores like parfor, with the same restrictions on the body.
+class ReductionNode final : public ExpressionNode {
+public:
+  enum class Kind : std::uint8_t {
+    Sum,
+    Product,
+    Min,
+    Max,
+  };
+
+  ReductionNode(Kind kind,
+                std::unique_ptr<VariableDefinitionStatement> init,
+                std::unique_ptr<ExpressionNode> end,
+                std::list<std::unique_ptr<BaseNode>> body,
+                bool parallel);
+
+  [[nodiscard]] std::string toString() const override;
+
+  void visit(NodeVisitor *visitor) const override;
+
+  const Kind kind;
+  const std::unique_ptr<VariableDefinitionStatement> init;
+  const std::unique_ptr<ExpressionNode> end;
+  const std::list<std::unique_ptr<BaseNode>> body;
+  const bool parallel;
+};
+
+#endif //REDUCTIONNODE_H
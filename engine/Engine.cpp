@@ -0,0 +1,237 @@
+#include "Engine.h"
+
+#include <cstdio>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include "llvm/Support/TargetSelect.h"
+
+#include "Lexer.h"
+#include "ScriptParser.h"
+#include "ir/BatchWrapper.h"
+#include "ir/GlobalVariables.h"
+#include "ir/ParallelCodegen.h"
+
+namespace {
+    double print(const double param) {
+        printf("print: %f\n", param);
+        return param;
+    }
+
+    llvm::Error engineError(const std::string &message) {
+        return llvm::createStringError(llvm::inconvertibleErrorCode(), message);
+    }
+
+    void initializeNativeTarget() {
+        static std::once_flag once;
+        std::call_once(once, [] {
+            llvm::InitializeNativeTarget();
+            llvm::InitializeNativeTargetAsmPrinter();
+            llvm::InitializeNativeTargetAsmParser();
+        });
+    }
+} // namespace
+
+Engine::Engine(std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit,
+               const unsigned codegenThreads,
+               const FastMath &fastMath)
+    : jit(std::move(jit)),
+      codegenThreads(codegenThreads),
+      fastMath(fastMath) {
+}
+
+llvm::Expected<std::unique_ptr<Engine> > Engine::Create(const EngineOptions &options) {
+    initializeNativeTarget();
+    auto jit = llvm::orc::KaleidoscopeJIT::Create(options.jit);
+    if (!jit) {
+        return jit.takeError();
+    }
+    std::unique_ptr<Engine> engine(new Engine(std::move(*jit), options.codegenThreads, options.fastMath));
+    if (auto error = engine->defineHostFunctions(options.hostFunctions)) {
+        return error;
+    }
+    return engine;
+}
+
+llvm::Error Engine::compile(const std::string &source) {
+    const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(source));
+    std::vector<std::unique_ptr<FunctionNode> > definitions;
+    lexer->readNextToken();
+    while (lexer->hasNextToken()) {
+        if (lexer->getCurrentToken() != TokenType::FunctionDefinitionToken) {
+            return engineError("compile() accepts only defs, top-level expressions are run by evaluate()");
+        }
+        auto definition = parseFunctionDefinition(lexer);
+        if (definition == nullptr || definition->proto == nullptr) {
+            return engineError("syntax error in a def");
+        }
+        definitions.push_back(std::move(definition));
+        lexer->readNextToken(); // eat '}'
+    }
+    std::vector<const FunctionNode *> functions;
+    for (const auto &definition: definitions) {
+        functions.push_back(definition.get());
+    }
+
+    std::lock_guard lock(mutex);
+    for (const auto *const function: functions) {
+        if (functionProtos.contains(function->proto->name)) {
+            return engineError("redefinition of " + function->proto->name);
+        }
+    }
+    auto modules = generateModules(functions,
+                                   functionProtos,
+                                   jit->getDataLayout(),
+                                   jit->getTargetMachineBuilder().getTargetTriple().str(),
+                                   codegenThreads,
+                                   fastMath,
+                                   globals);
+    if (modules.size() != functions.size()) {
+        for (const auto *const function: functions) {
+            functionProtos.erase(function->proto->name);
+        }
+        return engineError("can't generate code for a def");
+    }
+    for (auto &module: modules) {
+        module.withModuleDo([&functions](llvm::Module &llvmModule) {
+            for (const auto *const function: functions) {
+                if (auto *const definition = llvmModule.getFunction(function->proto->name);
+                    definition != nullptr && !definition->isDeclaration()) {
+                    generateBatchWrapper(*definition);
+                }
+            }
+        });
+        if (auto error = jit->addLazyModule(std::move(module), nullptr)) {
+            return error;
+        }
+    }
+    return llvm::Error::success();
+}
+
+llvm::Expected<double> Engine::evaluate(const std::string &source) {
+    const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(source));
+    lexer->readNextToken();
+    // Unique per call, so that concurrent evaluations don't clash in the JITDylib.
+    const auto name = "__expr" + std::to_string(nextExpressionId++);
+    const auto function = parseTopLevelExpr(lexer, name.c_str());
+    if (function->body.empty() || lexer->hasNextToken()) {
+        return engineError("evaluate() accepts only expressions, defs are added by compile()");
+    }
+
+    const auto resourceTracker = jit->getMainJITDylib().createResourceTracker();
+    {
+        std::lock_guard lock(mutex);
+        if (auto error = defineGlobals(globalsAssignedBy(*function))) {
+            return error;
+        }
+        auto modules = generateModules({function.get()},
+                                       functionProtos,
+                                       jit->getDataLayout(),
+                                       jit->getTargetMachineBuilder().getTargetTriple().str(),
+                                       1,
+                                       fastMath,
+                                       globals);
+        functionProtos.erase(name);
+        if (modules.empty()) {
+            return engineError("can't generate code for the expression");
+        }
+        if (auto error = jit->addModule(std::move(modules.front()), resourceTracker)) {
+            return error;
+        }
+    }
+    auto symbol = jit->lookup(name);
+    if (!symbol) {
+        return llvm::joinErrors(symbol.takeError(), resourceTracker->remove());
+    }
+    const double result = symbol->getAddress().toPtr<double (*)()>()();
+    if (auto error = resourceTracker->remove()) {
+        return error;
+    }
+    return result;
+}
+
+llvm::Expected<double *> Engine::global(const std::string &name) {
+    {
+        std::lock_guard lock(mutex);
+        if (auto error = defineGlobals({name})) {
+            return error;
+        }
+    }
+    auto symbol = jit->lookup(globalSymbolOf(name));
+    if (!symbol) {
+        return symbol.takeError();
+    }
+    return symbol->getAddress().toPtr<double *>();
+}
+
+llvm::Expected<llvm::orc::ExecutorAddr> Engine::lookupAddress(const std::string &name,
+                                                              const std::vector<NativeArg> &nativeArgs) {
+    {
+        std::lock_guard lock(mutex);
+        const auto proto = functionProtos.find(name);
+        if (proto == functionProtos.end()) {
+            return engineError("no def named " + name);
+        }
+        // A scalar arg is passed as a double, an array arg as a pointer followed by a size_t.
+        std::vector<NativeArg> expected;
+        std::string signature;
+        for (const bool array: proto->second->arrayArgs) {
+            signature += signature.empty() ? "" : ", ";
+            if (array) {
+                expected.insert(expected.end(), {NativeArg::Pointer, NativeArg::Size});
+                signature += "double *, size_t";
+            } else {
+                expected.push_back(NativeArg::Double);
+                signature += "double";
+            }
+        }
+        if (nativeArgs != expected) {
+            return engineError(name + " has the signature double(" + signature + ")");
+        }
+    }
+    auto symbol = jit->lookup(name);
+    if (!symbol) {
+        return symbol.takeError();
+    }
+    return symbol->getAddress();
+}
+
+llvm::Expected<Engine::BatchFunction *> Engine::lookupBatch(const std::string &name) {
+    {
+        std::lock_guard lock(mutex);
+        const auto proto = functionProtos.find(name);
+        if (proto == functionProtos.end()) {
+            return engineError("no def named " + name);
+        }
+        if (proto->second->nativeArity() != proto->second->args.size()) {
+            return engineError(name + " takes arrays and has no batch function");
+        }
+    }
+    auto symbol = jit->lookup(batchNameOf(name));
+    if (!symbol) {
+        return symbol.takeError();
+    }
+    return symbol->getAddress().toPtr<BatchFunction *>();
+}
+
+llvm::Error Engine::defineHostFunctions(HostFunctions hostFunctions) {
+    hostFunctions.add("print", &print, false);
+    hostFunctions.declare(functionProtos);
+    return hostFunctions.define(*jit);
+}
+
+llvm::Error Engine::defineGlobals(const std::vector<std::string> &names) {
+    for (const auto &name: names) {
+        if (globals.contains(name)) {
+            continue;
+        }
+        // Without a tracker of its own the global stays as long as the JIT.
+        auto module = defineGlobal(name, jit->getDataLayout(), jit->getTargetMachineBuilder().getTargetTriple().str());
+        if (auto error = jit->addModule(std::move(module), nullptr)) {
+            return error;
+        }
+        globals.insert(name);
+    }
+    return llvm::Error::success();
+}
@@ -0,0 +1,125 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "llvm/Support/Error.h"
+#include "llvm/Support/Threading.h"
+
+#include "HostFunctions.h"
+#include "KaleidoscopeJIT.h"
+#include "ast/FastMath.h"
+#include "ast/ProtoFunctionStatement.h"
+
+struct EngineOptions {
+    // Scripts see the host functions and print only, unless jit.searchProcessSymbols is set.
+    llvm::orc::JITOptions jit = {.searchProcessSymbols = false};
+    HostFunctions hostFunctions;
+    // Threads which generate the IR of the defs of one compile() call.
+    unsigned codegenThreads = llvm::hardware_concurrency().compute_thread_count();
+    // Fast-math flags of the defs and expressions without a fast or strict attribute; strict IEEE semantics unless set.
+    FastMath fastMath;
+};
+
+// Signatures of script functions: doubles in, a double out. An array arg a[] is passed as a pointer to the first
+// element of a host buffer, followed by the number of elements; the buffer is used in place, without a copy.
+template<typename Arg>
+inline constexpr bool isScriptArg = std::is_same_v<Arg, double> || std::is_same_v<Arg, const double *>
+                                    || std::is_same_v<Arg, double *> || std::is_same_v<Arg, std::size_t>;
+
+template<typename>
+struct IsScriptSignature : std::false_type {
+};
+
+template<typename... Args>
+struct IsScriptSignature<double(Args...)> : std::bool_constant<(isScriptArg<Args> && ...)> {
+};
+
+// Compiles scripts into the JIT of the process and hands out native pointers to their functions. All members may be
+// called concurrently: compile() and evaluate() serialize code generation, lookups and calls of compiled functions
+// don't take the engine lock. Functions stay valid as long as the engine.
+class Engine final {
+public:
+    static llvm::Expected<std::unique_ptr<Engine> > Create(const EngineOptions &options = {});
+
+    // Compiles the defs of the source; a def may call the defs of earlier compile() calls and redefine none of them.
+    // The source may not contain top-level expressions, see evaluate().
+    llvm::Error compile(const std::string &source);
+
+    // Runs top-level expressions which may call compiled defs, returns the value of the last one. An assignment
+    // x = ...; among the expressions writes the global x, which later expressions and defs compiled afterwards read.
+    llvm::Expected<double> evaluate(const std::string &source);
+
+    // Address of a global in JIT memory, which is created with the value 0 unless an expression assigned it already.
+    // The host may read and write it between calls of compiled functions, without compiling anything again.
+    llvm::Expected<double *> global(const std::string &name);
+
+    // Address of a compiled def, e.g. lookup<double(double, double)>("f"), or lookup<double(const double *, size_t)>
+    // ("sum") for def sum(a[]). Calls through the pointer are plain native calls; the signature must pass a double for
+    // every scalar arg of the def and a pointer followed by a size_t for every array arg.
+    template<typename Signature>
+    llvm::Expected<Signature *> lookup(const std::string &name) {
+        static_assert(IsScriptSignature<Signature>::value, "script functions take and return doubles");
+        auto address = lookupAddress(name, nativeArgsOf(static_cast<Signature *>(nullptr)));
+        if (!address) {
+            return address.takeError();
+        }
+        return address->toPtr<Signature *>();
+    }
+
+    // Evaluates a def over columns of its arguments: out[row] = f(columns[0][row], columns[1][row], ...) for every
+    // row below n. The def is inlined into the loop and vectorized for the host CPU; out may not overlap a column.
+    // Defs taking arrays have no batch function.
+    using BatchFunction = void(const double *const *columns, double *out, std::size_t n);
+
+    llvm::Expected<BatchFunction *> lookupBatch(const std::string &name);
+
+    llvm::orc::KaleidoscopeJIT &getJIT() { return *jit; }
+
+private:
+    Engine(std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit, unsigned codegenThreads, const FastMath &fastMath);
+
+    enum class NativeArg { Double, Pointer, Size };
+
+    template<typename Arg>
+    static constexpr NativeArg nativeArgOf() {
+        if constexpr (std::is_same_v<Arg, double>) {
+            return NativeArg::Double;
+        } else if constexpr (std::is_same_v<Arg, std::size_t>) {
+            return NativeArg::Size;
+        } else {
+            return NativeArg::Pointer;
+        }
+    }
+
+    template<typename... Args>
+    static std::vector<NativeArg> nativeArgsOf(double (*)(Args...)) { return {nativeArgOf<Args>()...}; }
+
+    llvm::Expected<llvm::orc::ExecutorAddr> lookupAddress(const std::string &name,
+                                                          const std::vector<NativeArg> &nativeArgs);
+
+    llvm::Error defineHostFunctions(HostFunctions hostFunctions);
+
+    // Needs the engine lock.
+    llvm::Error defineGlobals(const std::vector<std::string> &names);
+
+    const std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit;
+    const unsigned codegenThreads;
+    const FastMath fastMath;
+    // Guards the prototypes, which code generation reads and extends.
+    std::mutex mutex;
+    std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > functionProtos;
+    std::unordered_set<std::string> globals;
+    std::atomic<std::uint64_t> nextExpressionId{0};
+};
+
+#endif //ENGINE_H
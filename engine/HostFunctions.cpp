@@ -0,0 +1,70 @@
+#include "HostFunctions.h"
+
+#include <algorithm>
+
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+namespace {
+    bool takesAndReturnsDoubles(const llvm::Function &function) {
+        const auto *const type = function.getFunctionType();
+        return type->getReturnType()->isDoubleTy() && !type->isVarArg()
+               && std::all_of(type->param_begin(), type->param_end(), [](const llvm::Type *const param) {
+                   return param->isDoubleTy();
+               });
+    }
+
+    std::vector<std::string> argNames(const std::size_t arity) {
+        std::vector<std::string> names;
+        for (std::size_t i = 0; i < arity; ++i) {
+            names.push_back("arg" + std::to_string(i));
+        }
+        return names;
+    }
+} // namespace
+
+llvm::Error HostFunctions::addBitcode(const llvm::MemoryBufferRef bitcode) {
+    llvm::LLVMContext context;
+    auto module = llvm::parseBitcodeFile(bitcode, context);
+    if (!module) {
+        return module.takeError();
+    }
+    for (const auto &function: **module) {
+        if (function.isDeclaration() || !function.hasExternalLinkage() || !takesAndReturnsDoubles(function)) {
+            continue;
+        }
+        functions.push_back({function.getName().str(), function.arg_size(), function.doesNotAccessMemory(), {}});
+    }
+    bitcodes.emplace_back(bitcode.getBuffer());
+    return llvm::Error::success();
+}
+
+void HostFunctions::declare(
+    std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > &functionProtos) const {
+    for (const auto &function: functions) {
+        auto proto = std::make_unique<ProtoFunctionStatement>(function.name, argNames(function.arity), function.pure);
+        proto->willReturn = function.pure;
+        functionProtos[function.name] = std::move(proto);
+    }
+}
+
+llvm::Error HostFunctions::define(llvm::orc::KaleidoscopeJIT &jit) const {
+    llvm::orc::MangleAndInterner mangle(jit.getMainJITDylib().getExecutionSession(), jit.getDataLayout());
+    llvm::orc::SymbolMap symbols;
+    for (const auto &function: functions) {
+        if (function.address) {
+            symbols[mangle(function.name)] = {
+                function.address,
+                llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable
+            };
+        }
+    }
+    for (const auto &bitcode: bitcodes) {
+        jit.addBuiltinBitcode(bitcode);
+    }
+    if (symbols.empty()) {
+        return llvm::Error::success();
+    }
+    return jit.getMainJITDylib().define(absoluteSymbols(std::move(symbols)));
+}
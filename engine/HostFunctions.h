@@ -0,0 +1,55 @@
+#ifndef HOSTFUNCTIONS_H
+#define HOSTFUNCTIONS_H
+
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "llvm/ExecutionEngine/Orc/Shared/ExecutorAddress.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include "KaleidoscopeJIT.h"
+#include "ast/ProtoFunctionStatement.h"
+
+// Functions of the host which scripts may call. Native functions are bound to their addresses up front, bitcode
+// builtins are linked into the modules calling them so that small helpers inline into the script code.
+class HostFunctions final {
+public:
+    struct Function {
+        std::string name;
+        std::size_t arity;
+        // Neither reads nor writes memory of the script, always returns and never throws: see
+        // ProtoFunctionStatement::pure and willReturn.
+        bool pure;
+        // Null for bitcode builtins.
+        llvm::orc::ExecutorAddr address;
+    };
+
+    // A native function taking and returning doubles, e.g. add("hypot", &hypot, true).
+    template<typename... Args>
+    void add(const std::string &name, double (*const function)(Args...), const bool pure) {
+        static_assert((std::is_same_v<Args, double> && ...), "host functions take and return doubles");
+        functions.push_back({name, sizeof...(Args), pure, llvm::orc::ExecutorAddr::fromPtr(function)});
+    }
+
+    // Registers every externally visible function of the bitcode which takes and returns doubles. A function is
+    // pure when it is marked readnone, e.g. with __attribute__((const)).
+    llvm::Error addBitcode(llvm::MemoryBufferRef bitcode);
+
+    [[nodiscard]] const std::vector<Function> &getFunctions() const { return functions; }
+
+    // Prototypes which let scripts call the functions.
+    void declare(std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > &functionProtos) const;
+
+    // Defines the native functions in the main JITDylib and hands the bitcode to the JIT.
+    llvm::Error define(llvm::orc::KaleidoscopeJIT &jit) const;
+
+private:
+    std::vector<Function> functions;
+    std::vector<std::string> bitcodes;
+};
+
+#endif //HOSTFUNCTIONS_H
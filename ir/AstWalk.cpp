@@ -0,0 +1,84 @@
+#include "AstWalk.h"
+
+#include "ast/ArrayAccessNode.h"
+#include "ast/ArrayAssignmentStatement.h"
+#include "ast/BinOpNode.h"
+#include "ast/CallFunctionNode.h"
+#include "ast/ForLoopNode.h"
+#include "ast/IfStatement.h"
+#include "ast/ReductionNode.h"
+#include "ast/UnaryOpNode.h"
+#include "ast/VariableAccessNode.h"
+#include "ast/VariableDefinitionStatement.h"
+
+void walk(const std::list<std::unique_ptr<BaseNode> > &nodes,
+          const std::function<void(const BaseNode *)> &visitor) {
+    for (const auto &node: nodes) {
+        walk(node.get(), visitor);
+    }
+}
+
+void walk(const BaseNode *const node, const std::function<void(const BaseNode *)> &visitor) {
+    if (node == nullptr) {
+        return;
+    }
+    visitor(node);
+    if (const auto *const assignment = dynamic_cast<const ArrayAssignmentStatement *>(node)) {
+        walk(assignment->index.get(), visitor);
+        walk(assignment->rvalue.get(), visitor);
+    } else if (const auto *const access = dynamic_cast<const ArrayAccessNode *>(node)) {
+        walk(access->index.get(), visitor);
+    } else if (const auto *const call = dynamic_cast<const CallFunctionNode *>(node)) {
+        for (const auto &arg: call->args) {
+            walk(arg.get(), visitor);
+        }
+    } else if (const auto *const binOp = dynamic_cast<const BinOpNode *>(node)) {
+        walk(binOp->lhs.get(), visitor);
+        walk(binOp->rhs.get(), visitor);
+    } else if (const auto *const unaryOp = dynamic_cast<const UnaryOpNode *>(node)) {
+        walk(unaryOp->expr.get(), visitor);
+    } else if (const auto *const definition = dynamic_cast<const VariableDefinitionStatement *>(node)) {
+        walk(definition->rvalue.get(), visitor);
+    } else if (const auto *const ifStatement = dynamic_cast<const IfStatement *>(node)) {
+        walk(ifStatement->cond.get(), visitor);
+        walk(ifStatement->thenBranch, visitor);
+        if (ifStatement->elseBranch.has_value()) {
+            walk(ifStatement->elseBranch.value(), visitor);
+        }
+    } else if (const auto *const loop = dynamic_cast<const ForLoopNode *>(node)) {
+        walk(loop->init.get(), visitor);
+        walk(loop->conditional.get(), visitor);
+        walk(loop->next.get(), visitor);
+        walk(loop->body, visitor);
+    } else if (const auto *const reduction = dynamic_cast<const ReductionNode *>(node)) {
+        walk(reduction->init.get(), visitor);
+        walk(reduction->end.get(), visitor);
+        walk(reduction->body, visitor);
+    }
+}
+
+void collectVariables(const std::list<std::unique_ptr<BaseNode> > &nodes,
+                      std::vector<std::string> &read,
+                      std::unordered_set<std::string> &assigned) {
+    std::unordered_set<std::string> seen;
+    const auto use = [&read, &seen](const std::string &name) {
+        if (seen.insert(name).second) {
+            read.push_back(name);
+        }
+    };
+    walk(nodes, [&use, &assigned](const BaseNode *const node) {
+        if (const auto *const var = dynamic_cast<const VariableAccessNode *>(node)) {
+            use(var->name);
+        } else if (const auto *const access = dynamic_cast<const ArrayAccessNode *>(node)) {
+            use(access->name);
+        } else if (const auto *const assignment = dynamic_cast<const ArrayAssignmentStatement *>(node)) {
+            use(assignment->name);
+        } else if (const auto *const definition = dynamic_cast<const VariableDefinitionStatement *>(node)) {
+            assigned.insert(definition->name);
+        } else if (const auto *const unaryOp = dynamic_cast<const UnaryOpNode *>(node)) {
+            if (const auto *const var = dynamic_cast<const VariableAccessNode *>(unaryOp->expr.get())) {
+                assigned.insert(var->name);
+            }
+        }
+    });
+}
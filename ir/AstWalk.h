@@ -0,0 +1,23 @@
+#ifndef ASTWALK_H
+#define ASTWALK_H
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "ast/BaseNode.h"
+
+// Calls visitor for the node and every node below it, parents first.
+void walk(const BaseNode *node, const std::function<void(const BaseNode *)> &visitor);
+
+void walk(const std::list<std::unique_ptr<BaseNode> > &nodes, const std::function<void(const BaseNode *)> &visitor);
+
+// Variables the nodes read, in order of first use and including arrays, and those they assign.
+void collectVariables(const std::list<std::unique_ptr<BaseNode> > &nodes,
+                      std::vector<std::string> &read,
+                      std::unordered_set<std::string> &assigned);
+
+#endif //ASTWALK_H
@@ -0,0 +1,72 @@
+#include "BatchWrapper.h"
+
+#include <vector>
+
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+std::string batchNameOf(const std::string &name) {
+    return name + ".batch";
+}
+
+llvm::Function *generateBatchWrapper(llvm::Function &function) {
+    for (const auto &arg: function.args()) {
+        if (!arg.getType()->isDoubleTy()) {
+            return nullptr;
+        }
+    }
+    auto &module = *function.getParent();
+    auto &context = module.getContext();
+    auto *const pointerType = llvm::PointerType::getUnqual(context);
+    auto *const sizeType = module.getDataLayout().getIntPtrType(context);
+    auto *const wrapperType = llvm::FunctionType::get(llvm::Type::getVoidTy(context),
+                                                      {pointerType, pointerType, sizeType}, false);
+    auto *const wrapper = llvm::Function::Create(wrapperType, llvm::Function::ExternalLinkage,
+                                                 batchNameOf(function.getName().str()), module);
+    auto *const columns = wrapper->getArg(0);
+    auto *const out = wrapper->getArg(1);
+    auto *const rows = wrapper->getArg(2);
+    columns->setName("columns");
+    out->setName("out");
+    rows->setName("n");
+    // Rows are stored through out only, which lets the vectorizer skip runtime overlap checks against the columns.
+    wrapper->addParamAttr(0, llvm::Attribute::NoAlias);
+    wrapper->addParamAttr(0, llvm::Attribute::ReadOnly);
+    wrapper->addParamAttr(1, llvm::Attribute::NoAlias);
+
+    auto *const entryBlock = llvm::BasicBlock::Create(context, "entry", wrapper);
+    auto *const loopBlock = llvm::BasicBlock::Create(context, "loop", wrapper);
+    auto *const exitBlock = llvm::BasicBlock::Create(context, "exit", wrapper);
+    llvm::IRBuilder<> builder(entryBlock);
+    auto *const doubleType = builder.getDoubleTy();
+    // The column pointers are loaded once, ahead of the loop.
+    std::vector<llvm::Value *> columnPointers;
+    for (unsigned i = 0; i < function.arg_size(); ++i) {
+        columnPointers.push_back(builder.CreateLoad(pointerType,
+                                                    builder.CreateConstInBoundsGEP1_64(pointerType, columns, i),
+                                                    "column"));
+    }
+    builder.CreateCondBr(builder.CreateICmpEQ(rows, llvm::ConstantInt::get(sizeType, 0)), exitBlock, loopBlock);
+
+    builder.SetInsertPoint(loopBlock);
+    auto *const row = builder.CreatePHI(sizeType, 2, "row");
+    row->addIncoming(llvm::ConstantInt::get(sizeType, 0), entryBlock);
+    std::vector<llvm::Value *> args;
+    for (auto *const column: columnPointers) {
+        args.push_back(builder.CreateLoad(doubleType, builder.CreateInBoundsGEP(doubleType, column, row)));
+    }
+    auto *const call = builder.CreateCall(&function, args);
+    builder.CreateStore(call, builder.CreateInBoundsGEP(doubleType, out, row));
+    auto *const nextRow = builder.CreateNUWAdd(row, llvm::ConstantInt::get(sizeType, 1), "nextRow");
+    row->addIncoming(nextRow, loopBlock);
+    builder.CreateCondBr(builder.CreateICmpEQ(nextRow, rows), exitBlock, loopBlock);
+
+    builder.SetInsertPoint(exitBlock);
+    builder.CreateRetVoid();
+
+    // Should inlining fail, the call stays: the wrapper is still correct, just scalar.
+    llvm::InlineFunctionInfo inlineInfo;
+    static_cast<void>(llvm::InlineFunction(*call, inlineInfo));
+    return wrapper;
+}
@@ -0,0 +1,17 @@
+#ifndef BATCHWRAPPER_H
+#define BATCHWRAPPER_H
+
+#include <string>
+
+#include "llvm/IR/Function.h"
+
+// Name of the batch wrapper of a function, which can't clash with the defs of a script.
+std::string batchNameOf(const std::string &name);
+
+// Adds the batch wrapper of the function to its module: void(const double *const *columns, double *out, size_t n)
+// computing out[row] = function(columns[0][row], columns[1][row], ...) for every row below n. The function is
+// inlined into the loop, so the vectorizer can turn the wrapper into a SIMD kernel; out may not overlap a column.
+// Functions taking arrays get no wrapper, null is returned for them.
+llvm::Function *generateBatchWrapper(llvm::Function &function);
+
+#endif //BATCHWRAPPER_H
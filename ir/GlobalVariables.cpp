@@ -0,0 +1,53 @@
+#include "GlobalVariables.h"
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/LLVMContext.h"
+
+#include "ast/VariableDefinitionStatement.h"
+
+namespace {
+    constexpr llvm::StringLiteral globalSuffix = ".global";
+} // namespace
+
+std::string globalSymbolOf(const std::string &name) {
+    return name + globalSuffix.str();
+}
+
+std::optional<std::string> globalNameOf(const llvm::GlobalVariable &variable) {
+    auto name = variable.getName();
+    if (variable.hasLocalLinkage() || !variable.getValueType()->isDoubleTy() || !name.consume_back(globalSuffix)) {
+        return std::nullopt;
+    }
+    return name.str();
+}
+
+std::vector<std::string> globalsAssignedBy(const FunctionNode &expression) {
+    std::vector<std::string> names;
+    for (const auto &node: expression.body) {
+        if (const auto *const definition = dynamic_cast<const VariableDefinitionStatement *>(node.get())) {
+            names.push_back(definition->name);
+        }
+    }
+    return names;
+}
+
+llvm::orc::ThreadSafeModule defineGlobal(const std::string &name,
+                                         const llvm::DataLayout &dataLayout,
+                                         const std::string &targetTriple) {
+    auto llvmContext = std::make_unique<llvm::LLVMContext>();
+    auto llvmModule = std::make_unique<llvm::Module>(globalSymbolOf(name), *llvmContext);
+    llvmModule->setDataLayout(dataLayout);
+    llvmModule->setTargetTriple(targetTriple);
+    auto *const type = llvm::Type::getDoubleTy(*llvmContext);
+    new llvm::GlobalVariable(*llvmModule, type, false, llvm::GlobalValue::ExternalLinkage,
+                             llvm::ConstantFP::get(type, 0.0), globalSymbolOf(name));
+    return {std::move(llvmModule), std::move(llvmContext)};
+}
+
+void declareGlobals(llvm::Module &module, const std::unordered_set<std::string> &globals) {
+    auto *const type = llvm::Type::getDoubleTy(module.getContext());
+    for (const auto &name: globals) {
+        new llvm::GlobalVariable(module, type, false, llvm::GlobalValue::ExternalLinkage, nullptr,
+                                 globalSymbolOf(name));
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef GLOBALVARIABLES_H
+#define GLOBALVARIABLES_H
+
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Module.h"
+
+#include "ast/FunctionNode.h"
+
+// Globals of a script are doubles which outlive the top-level expression assigning them. Each one is defined once, in
+// a module of its own which stays in the JIT, and declared in every module generated later, where IRCodegen binds it
+// to its name. The host reads and writes a global through the address of its symbol.
+
+// Symbol of a global, which can't clash with the defs of a script.
+std::string globalSymbolOf(const std::string &name);
+
+// Name of the global the variable was declared for, none for other variables.
+std::optional<std::string> globalNameOf(const llvm::GlobalVariable &variable);
+
+// Variables assigned by the statements of a top-level expression, e.g. x for x = f(2); but not for if or loop bodies.
+std::vector<std::string> globalsAssignedBy(const FunctionNode &expression);
+
+// A module defining the global, initialized to 0.
+llvm::orc::ThreadSafeModule defineGlobal(const std::string &name,
+                                         const llvm::DataLayout &dataLayout,
+                                         const std::string &targetTriple);
+
+void declareGlobals(llvm::Module &module, const std::unordered_set<std::string> &globals);
+
+#endif //GLOBALVARIABLES_H
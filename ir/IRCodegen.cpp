@@ -2,12 +2,21 @@
 // Created by vadim on 06.10.24.
 //
 
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <functional>
 #include <list>
+#include <unordered_set>
 
 #include <llvm/IR/Function.h>
+#include <llvm/IR/Intrinsics.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Verifier.h>
 
+#include "ast/ArrayAccessNode.h"
+#include "ast/ArrayAssignmentStatement.h"
 #include "ast/FunctionNode.h"
 #include "ast/VariableAccessNode.h"
 #include "ast/VariableDefinitionStatement.h"
@@ -17,54 +26,199 @@
 #include "ast/UnaryOpNode.h"
 #include "ast/ForLoopNode.h"
 #include "ast/IfStatement.h"
+#include "ast/ReductionNode.h"
 
+#include "AstWalk.h"
+#include "GlobalVariables.h"
 #include "IRCodegen.h"
+#include "runtime/ParallelFor.h"
 
 namespace {
-    llvm::Value *codegenExpressions(const std::list<std::unique_ptr<BaseNode> > &expressions,
-                                    const std::unique_ptr<llvm::LLVMContext> &llvmContext,
-                                    const std::unique_ptr<llvm::IRBuilder<> > &llvmIRBuilder,
-                                    const std::unique_ptr<llvm::Module> &llvmModule,
-                                    std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > &
-                                    functionProtos,
-                                    std::unordered_map<std::string, llvm::Value *> &namedValues) {
-        for (auto it = expressions.begin(); it != expressions.end(); ++it) {
-            auto *const ir = generateIR(it->get(), llvmContext, llvmIRBuilder, llvmModule, functionProtos, namedValues);
-            if (auto *const var = dynamic_cast<VariableDefinitionStatement *>(it->get()); var != nullptr) {
-                namedValues[var->name] = ir;
+    // Creates a stack slot in the entry block of the function, so that mem2reg/SROA can promote it to a register.
+    llvm::AllocaInst *createEntryBlockAlloca(llvm::Function *const function,
+                                             llvm::Type *const type,
+                                             const std::string &name) {
+        llvm::IRBuilder<> builder(&function->getEntryBlock(), function->getEntryBlock().begin());
+        return builder.CreateAlloca(type, nullptr, name);
+    }
+
+    // Distinct self-referential loop ID, which keeps the metadata the passes attach to the loop (vectorization and
+    // unrolling decisions) apart from those of other loops. The loop isn't marked mustprogress: script loops may
+    // legitimately never terminate.
+    llvm::MDNode *createLoopID(llvm::LLVMContext &context) {
+        auto *const loopID = llvm::MDNode::getDistinct(context, {nullptr});
+        loopID->replaceOperandWith(0, loopID);
+        return loopID;
+    }
+
+    // Moves a block created up front to the end of the function, after the blocks generated in between.
+    void moveToEnd(llvm::BasicBlock *const block) {
+        block->moveAfter(&block->getParent()->back());
+    }
+
+    ValueType toValueType(const llvm::Type *const type) {
+        if (type->isIntegerTy(1)) {
+            return ValueType::Boolean;
+        }
+        if (type->isIntegerTy()) {
+            return ValueType::Integer;
+        }
+        return ValueType::Double;
+    }
+
+    struct MathBuiltin {
+        const char *name;
+        llvm::Intrinsic::ID intrinsic;
+        std::size_t arity;
+    };
+
+    // Math functions lowered to intrinsics instead of calls, so that LLVM folds, hoists and vectorizes them.
+    // min/max follow fmin/fmax and return the other operand when one is NaN.
+    constexpr std::array mathBuiltins{
+        MathBuiltin{"sqrt", llvm::Intrinsic::sqrt, 1},
+        MathBuiltin{"exp", llvm::Intrinsic::exp, 1},
+        MathBuiltin{"sin", llvm::Intrinsic::sin, 1},
+        MathBuiltin{"fabs", llvm::Intrinsic::fabs, 1},
+        MathBuiltin{"floor", llvm::Intrinsic::floor, 1},
+        MathBuiltin{"pow", llvm::Intrinsic::pow, 2},
+        MathBuiltin{"min", llvm::Intrinsic::minnum, 2},
+        MathBuiltin{"max", llvm::Intrinsic::maxnum, 2},
+        MathBuiltin{"fma", llvm::Intrinsic::fma, 3},
+    };
+
+    // Key of the length of an array in namedValues, which can't clash with a variable of the script.
+    std::string lengthNameOf(const std::string &array) {
+        return array + ".len";
+    }
+
+    // The arrays the nodes may write: assigned elements and arrays passed on to calls.
+    std::unordered_set<std::string> writtenArraysOf(const std::list<std::unique_ptr<BaseNode> > &nodes) {
+        std::unordered_set<std::string> arrays;
+        walk(nodes, [&arrays](const BaseNode *const node) {
+            if (const auto *const assignment = dynamic_cast<const ArrayAssignmentStatement *>(node)) {
+                arrays.insert(assignment->name);
+            } else if (const auto *const call = dynamic_cast<const CallFunctionNode *>(node)) {
+                for (const auto &arg: call->args) {
+                    if (const auto *const var = dynamic_cast<const VariableAccessNode *>(arg.get())) {
+                        arrays.insert(var->name);
+                    }
+                }
             }
-            if (*it == expressions.back() && ir != nullptr) {
-                return ir;
+        });
+        return arrays;
+    }
+
+    // Array pointers are readonly unless the function may write the array. They are noalias when the function
+    // has a single array, or writes none: overlapping buffers of the host can't be observed then.
+    void addArrayAttributes(llvm::Function &function,
+                            const ProtoFunctionStatement &proto,
+                            const std::list<std::unique_ptr<BaseNode> > &body) {
+        const auto writtenArrays = writtenArraysOf(body);
+        std::size_t arrays = 0;
+        bool anyWritten = false;
+        for (std::size_t i = 0; i < proto.args.size(); ++i) {
+            if (proto.isArray(i)) {
+                ++arrays;
+                anyWritten |= writtenArrays.contains(proto.args[i]);
             }
         }
-        return nullptr;
+        unsigned param = 0;
+        for (std::size_t i = 0; i < proto.args.size(); ++i) {
+            if (!proto.isArray(i)) {
+                ++param;
+                continue;
+            }
+            if (!writtenArrays.contains(proto.args[i])) {
+                function.addParamAttr(param, llvm::Attribute::ReadOnly);
+            }
+            if (arrays == 1 || !anyWritten) {
+                function.addParamAttr(param, llvm::Attribute::NoAlias);
+            }
+            param += 2;
+        }
+    }
+
+    llvm::FastMathFlags toFastMathFlags(const FastMath &fastMath) {
+        llvm::FastMathFlags flags;
+        flags.setAllowReassoc(fastMath.reassoc);
+        flags.setAllowContract(fastMath.contract);
+        flags.setNoNaNs(fastMath.noNaNs);
+        flags.setNoInfs(fastMath.noInfs);
+        flags.setNoSignedZeros(fastMath.noSignedZeros);
+        flags.setAllowReciprocal(fastMath.allowReciprocal);
+        return flags;
     }
 
-    llvm::Function *getFunction(const std::string &Name,
-                                const std::unique_ptr<llvm::LLVMContext> &llvmContext,
-                                const std::unique_ptr<llvm::IRBuilder<> > &llvmIRBuilder,
-                                const std::unique_ptr<llvm::Module> &llvmModule,
-                                std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > &
-                                functionProtos,
-                                std::unordered_map<std::string, llvm::Value *> &namedValues) {
-        // First, see if the function has already been added to the current module.
-        if (auto *const function = llvmModule->getFunction(Name)) {
-            return function;
+    // Passes which check the function rather than its instructions, e.g. the vectorizer for min/max reductions.
+    void addFastMathAttributes(llvm::Function &function, const FastMath &fastMath) {
+        if (fastMath.noNaNs) {
+            function.addFnAttr("no-nans-fp-math", "true");
         }
+        if (fastMath.noInfs) {
+            function.addFnAttr("no-infs-fp-math", "true");
+        }
+        if (fastMath.noSignedZeros) {
+            function.addFnAttr("no-signed-zeros-fp-math", "true");
+        }
+    }
 
-        // If not, check whether we can codegen the declaration from some existing
-        // prototype.
-        if (const auto iterator = functionProtos.find(Name); iterator != functionProtos.end()) {
-            IRCodegen codegen(llvmContext, llvmIRBuilder, llvmModule, functionProtos, namedValues);
-            iterator->second->visit(&codegen);
-            return reinterpret_cast<llvm::Function *>(codegen.value());
+    llvm::Value *reductionIdentity(const ReductionNode::Kind kind, llvm::Type *const type) {
+        switch (kind) {
+            case ReductionNode::Kind::Sum:
+                return llvm::ConstantFP::get(type, 0.0);
+            case ReductionNode::Kind::Product:
+                return llvm::ConstantFP::get(type, 1.0);
+            case ReductionNode::Kind::Min:
+                return llvm::ConstantFP::getInfinity(type, false);
+            case ReductionNode::Kind::Max:
+                break;
         }
+        return llvm::ConstantFP::getInfinity(type, true);
+    }
+
+    // Combines two partial results. Adds the fast-math flags documented on ReductionNode to those of the def, which
+    // lets the loop vectorizer keep several accumulators and add them up as a tree after the loop.
+    llvm::Value *combineReduction(llvm::IRBuilder<> &builder,
+                                  const ReductionNode::Kind kind,
+                                  llvm::Value *const lhs,
+                                  llvm::Value *const rhs) {
+        const llvm::IRBuilderBase::FastMathFlagGuard fastMathFlagGuard(builder);
+        auto flags = builder.getFastMathFlags();
+        switch (kind) {
+            case ReductionNode::Kind::Sum:
+                flags.setAllowReassoc();
+                builder.setFastMathFlags(flags);
+                return builder.CreateFAdd(lhs, rhs, "sum");
+            case ReductionNode::Kind::Product:
+                flags.setAllowReassoc();
+                builder.setFastMathFlags(flags);
+                return builder.CreateFMul(lhs, rhs, "product");
+            case ReductionNode::Kind::Min:
+            case ReductionNode::Kind::Max:
+                break;
+        }
+        flags.setNoNaNs();
+        flags.setNoSignedZeros();
+        builder.setFastMathFlags(flags);
+        return kind == ReductionNode::Kind::Min
+                   ? builder.CreateBinaryIntrinsic(llvm::Intrinsic::minnum, lhs, rhs, nullptr, "min")
+                   : builder.CreateBinaryIntrinsic(llvm::Intrinsic::maxnum, lhs, rhs, nullptr, "max");
+    }
 
-        // If no existing prototype exists, return null.
+    const MathBuiltin *findMathBuiltin(const std::string &name) {
+        for (const auto &builtin: mathBuiltins) {
+            if (name == builtin.name) {
+                return &builtin;
+            }
+        }
         return nullptr;
     }
 } // namespace
 
+bool isBuiltinFunction(const std::string &name) {
+    return name == "len" || findMathBuiltin(name) != nullptr;
+}
+
 IRCodegen::IRCodegen(
     const std::unique_ptr<llvm::LLVMContext> &llvmContext,
     const std::unique_ptr<llvm::IRBuilder<> > &llvmIRBuilder,
@@ -79,40 +233,87 @@ IRCodegen::IRCodegen(
 }
 
 void IRCodegen::visit(const VariableAccessNode *node) {
-    value_ = namedValues[node->name];
+    const auto variable = namedValues.find(node->name);
+    if (variable == namedValues.end()) {
+        return;
+    }
+    if (auto *const alloca = llvm::dyn_cast<llvm::AllocaInst>(variable->second)) {
+        value_ = llvmIRBuilder->CreateLoad(alloca->getAllocatedType(), alloca, node->name);
+    } else if (auto *const global = llvm::dyn_cast<llvm::GlobalVariable>(variable->second)) {
+        value_ = llvmIRBuilder->CreateLoad(global->getValueType(), global, node->name);
+    } else if (!variable->second->getType()->isPointerTy()) {
+        // Arrays are read through a[i] and len(a) only.
+        value_ = variable->second;
+    }
 }
 
 void IRCodegen::visit(const FunctionNode *const node) {
     assert(llvmContext != nullptr);
     // Transfer ownership of the prototype to the functionProtos map, but keep a
-    // reference to it for use below.
+    // reference to it for use below. A matching prototype is left untouched, so the map
+    // may be shared read-only by threads generating functions which were declared up front.
     const auto &p = *node->proto;
-    functionProtos[p.name] = std::make_unique<ProtoFunctionStatement>(node->proto->name,
-                                                                      node->proto->args);
-    auto *const function = getFunction(p.name,
-                                       llvmContext,
-                                       llvmIRBuilder,
-                                       llvmModule,
-                                       functionProtos,
-                                       namedValues
-    );
+    if (const auto proto = functionProtos.find(p.name);
+        proto == functionProtos.end() || proto->second->args != p.args || proto->second->arrayArgs != p.arrayArgs) {
+        functionProtos[p.name] = std::make_unique<ProtoFunctionStatement>(p.name, p.args, false, p.arrayArgs);
+        functionProtos[p.name]->fastMath = p.fastMath;
+    }
+    auto *const function = getFunction(p.name);
     if (function == nullptr) {
         return;
     }
+    // Every floating-point instruction of the body, including the outlined parts, gets the flags of the def. A
+    // registered prototype carries the flags of the engine when the def has none.
+    const auto fastMath = functionProtos.at(p.name)->fastMath.value_or(FastMath{});
+    const llvm::IRBuilderBase::FastMathFlagGuard fastMathFlagGuard(*llvmIRBuilder);
+    llvmIRBuilder->setFastMathFlags(toFastMathFlags(fastMath));
+    addFastMathAttributes(*function, fastMath);
 
     // Create a new basic block to start insertion into.
     auto *const basicBlock = llvm::BasicBlock::Create(*llvmContext, "entry", function);
     llvmIRBuilder->SetInsertPoint(basicBlock);
 
-    // Record the function arguments in the namedValues map.
+    // The globals declared in the module are visible in every function. A def assigning a variable of the same name
+    // gets a local variable instead, the assignments of a top-level expression write the global.
+    std::vector<std::string> read;
+    std::unordered_set<std::string> assigned;
+    collectVariables(node->body, read, assigned);
+    assigned.insert(p.args.begin(), p.args.end());
+    std::unordered_map<std::string, llvm::GlobalVariable *> globals;
+    for (auto &variable: llvmModule->globals()) {
+        if (const auto name = globalNameOf(variable); name.has_value() && (p.topLevel || !assigned.contains(*name))) {
+            globals[*name] = &variable;
+        }
+    }
+    std::vector<std::string> globalNames;
+    for (const auto &[name, variable]: globals) {
+        globalNames.push_back(name);
+    }
+    auto functionVariableTypes = inferVariableTypes(node, globalNames);
+    variableTypes = &functionVariableTypes;
+
+    // Spill the scalar arguments to stack slots, so they can be reassigned in the body. Arrays are bound to the
+    // pointer and the length they were passed as.
     namedValues.clear();
-    for (auto &arg: function->args()) {
-        namedValues[std::string(arg.getName())] = &arg;
+    namedValues.insert(globals.begin(), globals.end());
+    auto *arg = function->arg_begin();
+    for (std::size_t i = 0; i < p.args.size(); ++i) {
+        const auto &name = p.args[i];
+        if (p.isArray(i)) {
+            namedValues[name] = arg++;
+            namedValues[lengthNameOf(name)] = arg++;
+            continue;
+        }
+        auto *const alloca = createEntryBlockAlloca(function, toLLVMType(typeOf(name)), name);
+        llvmIRBuilder->CreateStore(convert(arg++, typeOf(name)), alloca);
+        namedValues[name] = alloca;
     }
+    addArrayAttributes(*function, p, node->body);
 
-    if (auto *const returnValue = codegenExpressions(node->body, llvmContext, llvmIRBuilder, llvmModule, functionProtos,
-                                                     namedValues)) {
-        llvmIRBuilder->CreateRet(returnValue);
+    auto *const returnValue = generateBlock(node->body);
+    variableTypes = nullptr;
+    if (returnValue != nullptr) {
+        llvmIRBuilder->CreateRet(convert(returnValue, ValueType::Double));
         verifyFunction(*function);
         value_ = function;
         return;
@@ -124,29 +325,43 @@ void IRCodegen::visit(const FunctionNode *const node) {
 
 void IRCodegen::visit(const NumberNode *node) {
     assert(llvmContext != nullptr);
+    if (node->isInteger) {
+        // In range by construction, see NumberNode::isInteger.
+        assert(std::abs(node->value) < 0x1p63);
+        value_ = llvmIRBuilder->getInt64(static_cast<std::int64_t>(node->value));
+        return;
+    }
     value_ = llvm::ConstantFP::get(*llvmContext, llvm::APFloat(node->value));
 }
 
 void IRCodegen::visit(const BinOpNode *node) {
     assert(llvmContext != nullptr);
-    auto *lhsValue = generateIR(node->lhs.get(), llvmContext, llvmIRBuilder, llvmModule, functionProtos, namedValues);
-    auto *rhsValue = generateIR(node->rhs.get(), llvmContext, llvmIRBuilder, llvmModule, functionProtos, namedValues);
+    auto *lhsValue = generate(node->lhs.get());
+    auto *rhsValue = generate(node->rhs.get());
     if (lhsValue == nullptr || rhsValue == nullptr) {
         return;
     }
-    if (lhsValue->getType()->isPointerTy()) {
-        lhsValue = llvmIRBuilder->CreateLoad(llvm::Type::getDoubleTy(*llvmContext), lhsValue);
-    }
-    if (rhsValue->getType()->isPointerTy()) {
-        rhsValue = llvmIRBuilder->CreateLoad(llvm::Type::getDoubleTy(*llvmContext), rhsValue);
-    }
+
+    // Integer operands of +, - and comparisons stay in integer registers and wrap around on overflow, everything
+    // else is computed in double precision; see inferVariableTypes().
+    const auto operandType = node->binOp == TokenType::DivideToken || node->binOp == TokenType::MultiplyToken
+                                 ? ValueType::Double
+                                 : join(join(toValueType(lhsValue->getType()), toValueType(rhsValue->getType())),
+                                        ValueType::Integer);
+    lhsValue = convert(lhsValue, operandType);
+    rhsValue = convert(rhsValue, operandType);
+    const bool isInteger = operandType == ValueType::Integer;
 
     switch (node->binOp) {
         case TokenType::PlusToken:
-            value_ = llvmIRBuilder->CreateFAdd(lhsValue, rhsValue, "add_tmp");
+            value_ = isInteger
+                         ? llvmIRBuilder->CreateAdd(lhsValue, rhsValue, "add_tmp")
+                         : llvmIRBuilder->CreateFAdd(lhsValue, rhsValue, "add_tmp");
             return;
         case TokenType::MinusToken:
-            value_ = llvmIRBuilder->CreateFSub(lhsValue, rhsValue, "sub_tmp");
+            value_ = isInteger
+                         ? llvmIRBuilder->CreateSub(lhsValue, rhsValue, "sub_tmp")
+                         : llvmIRBuilder->CreateFSub(lhsValue, rhsValue, "sub_tmp");
             return;
         case TokenType::MultiplyToken:
             value_ = llvmIRBuilder->CreateFMul(lhsValue, rhsValue, "mul_tmp");
@@ -155,9 +370,15 @@ void IRCodegen::visit(const BinOpNode *node) {
             value_ = llvmIRBuilder->CreateFDiv(lhsValue, rhsValue, "div_tmp");
             return;
         case TokenType::LeftAngleBracketToken:
-            lhsValue = llvmIRBuilder->CreateFCmpULT(lhsValue, rhsValue, "cmp_tmp");
-        // Convert bool 0/1 to double 0.0 or 1.0
-            value_ = llvmIRBuilder->CreateUIToFP(lhsValue, llvm::Type::getDoubleTy(*llvmContext), "bool_tmp");
+            value_ = isInteger
+                         ? llvmIRBuilder->CreateICmpSLT(lhsValue, rhsValue, "cmp_tmp")
+                         : llvmIRBuilder->CreateFCmpULT(lhsValue, rhsValue, "cmp_tmp");
+            return;
+        case TokenType::RightAngleBracketToken:
+            value_ = isInteger
+                         ? llvmIRBuilder->CreateICmpSGT(lhsValue, rhsValue, "cmp_tmp")
+                         : llvmIRBuilder->CreateFCmpUGT(lhsValue, rhsValue, "cmp_tmp");
+            return;
         default:
             break;
     }
@@ -165,16 +386,39 @@ void IRCodegen::visit(const BinOpNode *node) {
 
 void IRCodegen::visit(const ProtoFunctionStatement *node) {
     assert(llvmContext != nullptr);
-    std::vector const functionParams(node->args.size(), llvm::Type::getDoubleTy(*llvmContext));
+    // An array is passed as a pointer to its first element and its length.
+    std::vector<llvm::Type *> functionParams;
+    for (std::size_t i = 0; i < node->args.size(); ++i) {
+        if (node->isArray(i)) {
+            functionParams.push_back(llvmIRBuilder->getPtrTy());
+            functionParams.push_back(llvmIRBuilder->getInt64Ty());
+        } else {
+            functionParams.push_back(llvmIRBuilder->getDoubleTy());
+        }
+    }
     auto *const functionType = llvm::FunctionType::get(llvm::Type::getDoubleTy(*llvmContext), functionParams,
                                                        false);
     auto *const function = llvm::Function::Create(functionType,
                                                   llvm::Function::ExternalLinkage,
                                                   node->name,
                                                   llvmModule.get());
-    for (auto *it = function->arg_begin(); it != function->arg_end(); ++it) {
-        const auto index = std::distance(function->arg_begin(), it);
-        it->setName(node->args[index]);
+    auto *arg = function->arg_begin();
+    for (std::size_t i = 0; i < node->args.size(); ++i) {
+        (arg++)->setName(node->args[i]);
+        if (node->isArray(i)) {
+            (arg++)->setName(lengthNameOf(node->args[i]));
+        }
+    }
+    // Calls of pure functions can be hoisted and merged, and removed when unused if they also return.
+    if (node->pure) {
+        function->setDoesNotAccessMemory();
+    }
+    if (node->willReturn) {
+        function->setDoesNotThrow();
+        function->setWillReturn();
+    }
+    if (node->speculatable) {
+        function->addFnAttr(llvm::Attribute::Speculatable);
     }
     value_ = function;
 }
@@ -191,70 +435,120 @@ void IRCodegen::visit(const VariableDefinitionStatement *const node) {
             node->name
         );
 
-        auto *const init = generateIR(node->rvalue.get(), llvmContext, llvmIRBuilder, llvmModule, functionProtos,
-                                      namedValues);
+        auto *const init = generate(node->rvalue.get());
         variable->setInitializer(reinterpret_cast<llvm::ConstantFP *>(init));
+        namedValues[node->name] = variable;
         value_ = variable;
         return;
     }
-    auto *const variable = new llvm::AllocaInst(llvmIRBuilder->getDoubleTy(), 0, node->name,
-                                                llvmIRBuilder->GetInsertBlock());
-
-    llvmIRBuilder->CreateStore(
-        generateIR(node->rvalue.get(), llvmContext, llvmIRBuilder, llvmModule, functionProtos, namedValues),
-        variable
-    );
-    value_ = variable;
+    auto *const rvalue = generate(node->rvalue.get());
+    if (rvalue == nullptr) {
+        return;
+    }
+    if (auto *const global = llvm::dyn_cast_or_null<llvm::GlobalVariable>(namedValues[node->name])) {
+        llvmIRBuilder->CreateStore(convert(rvalue, ValueType::Double), global);
+        value_ = rvalue;
+        return;
+    }
+    // Reassignment stores into the existing stack slot, the first assignment creates it.
+    auto *const function = llvmIRBuilder->GetInsertBlock()->getParent();
+    auto *variable = llvm::dyn_cast_or_null<llvm::AllocaInst>(namedValues[node->name]);
+    if (variable == nullptr || variable->getFunction() != function) {
+        variable = createEntryBlockAlloca(function, toLLVMType(typeOf(node->name)), node->name);
+        namedValues[node->name] = variable;
+    }
+    llvmIRBuilder->CreateStore(convert(rvalue, toValueType(variable->getAllocatedType())), variable);
+    value_ = rvalue;
 }
 
 void IRCodegen::visit(const CallFunctionNode *const node) {
     assert(llvmContext != nullptr);
+    if (node->callee == "len" && !functionProtos.contains(node->callee)) {
+        if (node->args.size() != 1) {
+            return;
+        }
+        if (const auto *const array = dynamic_cast<const VariableAccessNode *>(node->args.front().get())) {
+            if (const auto length = namedValues.find(lengthNameOf(array->name)); length != namedValues.end()) {
+                value_ = length->second;
+            }
+        }
+        return;
+    }
+    // A def or host function of the same name takes precedence over the builtin.
+    if (const auto *const builtin = findMathBuiltin(node->callee);
+        builtin != nullptr && !functionProtos.contains(node->callee)
+        && llvmModule->getFunction(node->callee) == nullptr) {
+        if (node->args.size() == builtin->arity) {
+            generateIntrinsicCall(builtin->intrinsic, node);
+        }
+        return;
+    }
+
     // Look up the name in the global module table.
-    auto *calleeFunc = getFunction(node->callee,
-                                   llvmContext,
-                                   llvmIRBuilder,
-                                   llvmModule,
-                                   functionProtos,
-                                   namedValues);
+    auto *calleeFunc = getFunction(node->callee);
     if (calleeFunc == nullptr) {
         return;
     }
 
     // If argument mismatch error.
-    if (calleeFunc->arg_size() != node->args.size()) {
+    const auto proto = functionProtos.find(node->callee);
+    const auto *const calleeProto = proto != functionProtos.end() ? proto->second.get() : nullptr;
+    if ((calleeProto != nullptr ? calleeProto->args.size() : calleeFunc->arg_size()) != node->args.size()) {
         return;
     }
 
     std::vector<llvm::Value *> argsFunc;
-    for (const auto &arg: node->args) {
-        argsFunc.push_back(
-            generateIR(arg.get(),
-                llvmContext,
-                llvmIRBuilder,
-                llvmModule,
-                functionProtos,
-                namedValues));
-        if (!argsFunc.back()) {
+    for (std::size_t i = 0; i < node->args.size(); ++i) {
+        const auto &arg = node->args[i];
+        // Arrays are passed on by name, as the pointer and the length of the caller's array.
+        if (calleeProto != nullptr && calleeProto->isArray(i)) {
+            const auto *const array = dynamic_cast<const VariableAccessNode *>(arg.get());
+            if (array == nullptr) {
+                return;
+            }
+            const auto pointer = namedValues.find(array->name);
+            const auto length = namedValues.find(lengthNameOf(array->name));
+            if (pointer == namedValues.end() || length == namedValues.end()) {
+                return;
+            }
+            argsFunc.push_back(pointer->second);
+            argsFunc.push_back(length->second);
+            continue;
+        }
+        auto *const argValue = generate(arg.get());
+        if (argValue == nullptr) {
             return;
         }
+        argsFunc.push_back(convert(argValue, ValueType::Double));
     }
 
     value_ = llvmIRBuilder->CreateCall(calleeFunc, argsFunc, "calltmp");
 }
 
+void IRCodegen::generateIntrinsicCall(const llvm::Intrinsic::ID intrinsic, const CallFunctionNode *const node) {
+    std::vector<llvm::Value *> args;
+    for (const auto &arg: node->args) {
+        auto *const argValue = generate(arg.get());
+        if (argValue == nullptr) {
+            return;
+        }
+        args.push_back(convert(argValue, ValueType::Double));
+    }
+    // The declaration carries the intrinsic's own attributes: no memory access, no unwinding, speculatable.
+    value_ = llvmIRBuilder->CreateIntrinsic(intrinsic, {llvmIRBuilder->getDoubleTy()}, args, nullptr, node->callee);
+}
+
 void IRCodegen::visit(const IfStatement *node) {
-    auto *condValue = generateIR(node->cond.get(), llvmContext, llvmIRBuilder, llvmModule, functionProtos, namedValues);
+    auto *condValue = generate(node->cond.get());
     if (condValue == nullptr) {
         return;
     }
-    condValue = llvmIRBuilder->CreateFCmpONE(condValue,
-                                             llvm::ConstantFP::get(*llvmContext,
-                                                                   llvm::APFloat(0.0)),
-                                             "if_cond");
+    condValue = toCondition(condValue, "if_cond");
     auto *const insertBlock = llvmIRBuilder->GetInsertBlock();
     if (insertBlock == nullptr) {
         return;
     }
+    const auto resultType = typeOf(node);
     auto *const function = insertBlock->getParent();
     auto *thenBasicBlock = llvm::BasicBlock::Create(*llvmContext, "thenBasicBlock", function);
     auto *elseBasicBlock = llvm::BasicBlock::Create(*llvmContext, "elseBasicBlock");
@@ -265,21 +559,21 @@ void IRCodegen::visit(const IfStatement *node) {
 
     // then base block
     llvmIRBuilder->SetInsertPoint(thenBasicBlock);
-    auto *const thenValue = codegenExpressions(node->thenBranch, llvmContext, llvmIRBuilder, llvmModule, functionProtos,
-                                               namedValues);
+    auto *thenValue = generateBlock(node->thenBranch);
     if (thenValue == nullptr) {
         return;
     }
+    thenValue = convert(thenValue, resultType);
     llvmIRBuilder->CreateBr(finishBasicBlock);
     thenBasicBlock = llvmIRBuilder->GetInsertBlock();
 
     // else base block
     function->insert(function->end(), elseBasicBlock);
     llvmIRBuilder->SetInsertPoint(elseBasicBlock);
-    auto *const elseValue = node->elseBranch.has_value()
-                                ? codegenExpressions(node->elseBranch.value(), llvmContext, llvmIRBuilder, llvmModule,
-                                                     functionProtos, namedValues)
-                                : nullptr;
+    auto *elseValue = node->elseBranch.has_value() ? generateBlock(node->elseBranch.value()) : nullptr;
+    elseValue = elseValue != nullptr
+                    ? convert(elseValue, resultType)
+                    : llvm::Constant::getNullValue(toLLVMType(resultType));
     llvmIRBuilder->CreateBr(finishBasicBlock);
     elseBasicBlock = llvmIRBuilder->GetInsertBlock();
 
@@ -288,74 +582,98 @@ void IRCodegen::visit(const IfStatement *node) {
     llvmIRBuilder->SetInsertPoint(finishBasicBlock);
 
     // phi node
-    auto *const phiNode =
-            llvmIRBuilder->CreatePHI(llvm::Type::getDoubleTy(*llvmContext), 2, "if_tmp");
+    auto *const phiNode = llvmIRBuilder->CreatePHI(toLLVMType(resultType), 2, "if_tmp");
     phiNode->addIncoming(thenValue, thenBasicBlock);
-    phiNode->addIncoming(
-        elseValue ? elseValue : llvm::ConstantFP::getNullValue(llvm::Type::getDoubleTy(*llvmContext)),
-        elseBasicBlock);
+    phiNode->addIncoming(elseValue, elseBasicBlock);
     value_ = phiNode;
 }
 
 void IRCodegen::visit(const ForLoopNode *node) {
+    if (node->parallel) {
+        generateParallelFor(node);
+        return;
+    }
     assert(llvmIRBuilder->GetInsertBlock());
     auto *const currFunction = llvmIRBuilder->GetInsertBlock()->getParent();
-    auto *const beforeLoopBB = llvmIRBuilder->GetInsertBlock();
-    auto *const loopBB = llvm::BasicBlock::Create(*llvmContext,
-                                                  "for_loop",
-                                                  currFunction);
-    llvmIRBuilder->CreateBr(loopBB);
-    llvmIRBuilder->SetInsertPoint(loopBB);
 
     const auto *const initVarAst = dynamic_cast<const VariableDefinitionStatement *>(node->init.get());
     if (initVarAst == nullptr) {
         return;
     }
-    auto *const loopVarValue = llvmIRBuilder->CreatePHI(llvm::Type::getDoubleTy(*llvmContext),
-                                                        2,
-                                                        initVarAst->name);
+    // The init value is computed before the loop variable shadows an outer one.
+    auto *const initValue = generate(initVarAst->rvalue.get());
+    if (initValue == nullptr) {
+        return;
+    }
+    const auto loopVarType = typeOf(initVarAst->name);
+    auto *const loopVar = createEntryBlockAlloca(currFunction, toLLVMType(loopVarType), initVarAst->name);
+    llvmIRBuilder->CreateStore(convert(initValue, loopVarType), loopVar);
     auto *const OldVar = namedValues[initVarAst->name];
-    namedValues[initVarAst->name] = loopVarValue;
+    namedValues[initVarAst->name] = loopVar;
 
-    auto *const initValue = generateIR(initVarAst->rvalue.get(), llvmContext, llvmIRBuilder, llvmModule, functionProtos,
-                                       namedValues);
-    if (initValue == nullptr) {
+    // The loop evaluates to the value of its body on the last iteration, or 0 if the body never ran.
+    const auto resultType = typeOf(node);
+    auto *const resultVar = createEntryBlockAlloca(currFunction, toLLVMType(resultType), "loop_result");
+    llvmIRBuilder->CreateStore(llvm::Constant::getNullValue(toLLVMType(resultType)), resultVar);
+
+    const auto generateCondition = [&]() -> llvm::Value * {
+        auto *const condExprValue = generate(node->conditional.get());
+        return condExprValue != nullptr ? toCondition(condExprValue, "loop_cond") : nullptr;
+    };
+
+    // Rotated loop: the guard skips the loop when the condition fails for the initial value, the body is entered
+    // through a dedicated preheader and the latch is the only block branching back to the body. The blocks belong to
+    // the function from the start, so that they go away with it when the codegen of the loop fails.
+    auto *const preheaderBB = llvm::BasicBlock::Create(*llvmContext, "for_preheader", currFunction);
+    auto *const bodyBB = llvm::BasicBlock::Create(*llvmContext, "for_body", currFunction);
+    auto *const latchBB = llvm::BasicBlock::Create(*llvmContext, "for_latch", currFunction);
+    auto *const afterLoopBB = llvm::BasicBlock::Create(*llvmContext, "after_loop", currFunction);
+
+    auto *const guardCond = generateCondition();
+    if (guardCond == nullptr) {
         return;
     }
-    loopVarValue->addIncoming(initValue, beforeLoopBB);
-    if (codegenExpressions(node->body, llvmContext, llvmIRBuilder, llvmModule, functionProtos, namedValues) ==
-        nullptr) {
+    llvmIRBuilder->CreateCondBr(guardCond, preheaderBB, afterLoopBB);
+    llvmIRBuilder->SetInsertPoint(preheaderBB);
+    llvmIRBuilder->CreateBr(bodyBB);
+
+    // body
+    llvmIRBuilder->SetInsertPoint(bodyBB);
+    auto *const bodyValue = generateBlock(node->body);
+    if (bodyValue == nullptr) {
         return;
     }
+    llvmIRBuilder->CreateStore(convert(bodyValue, resultType), resultVar);
+    llvmIRBuilder->CreateBr(latchBB);
 
+    // latch
+    moveToEnd(latchBB);
+    llvmIRBuilder->SetInsertPoint(latchBB);
     llvm::Value *nextValue;
     if (node->next) {
-        nextValue = generateIR(node->next.get(), llvmContext, llvmIRBuilder, llvmModule, functionProtos, namedValues);
+        nextValue = generate(node->next.get());
         if (nextValue == nullptr) {
             return;
         }
     } else {
-        nextValue = llvmIRBuilder->CreateFAdd(loopVarValue,
-                                              llvm::ConstantFP::get(*llvmContext, llvm::APFloat(1.0)),
-                                              "next_var");
+        auto *const currentValue = llvmIRBuilder->CreateLoad(loopVar->getAllocatedType(), loopVar,
+                                                             initVarAst->name);
+        nextValue = loopVarType == ValueType::Double
+                        ? llvmIRBuilder->CreateFAdd(currentValue,
+                                                    llvm::ConstantFP::get(*llvmContext, llvm::APFloat(1.0)),
+                                                    "next_var")
+                        : llvmIRBuilder->CreateAdd(currentValue, llvmIRBuilder->getInt64(1), "next_var");
     }
-
-    auto *condExprValue = generateIR(node->conditional.get(), llvmContext, llvmIRBuilder, llvmModule, functionProtos,
-                                     namedValues);
-    if (condExprValue == nullptr) {
+    llvmIRBuilder->CreateStore(convert(nextValue, loopVarType), loopVar);
+    auto *const latchCond = generateCondition();
+    if (latchCond == nullptr) {
         return;
     }
-    condExprValue = llvmIRBuilder->CreateFCmpONE(
-        condExprValue, llvm::ConstantFP::get(*llvmContext, llvm::APFloat(0.0)),
-        "loop_cond");
+    auto *const backEdge = llvmIRBuilder->CreateCondBr(latchCond, bodyBB, afterLoopBB);
+    backEdge->setMetadata(llvm::LLVMContext::MD_loop, createLoopID(*llvmContext));
 
-    auto *const loopEndBB = llvmIRBuilder->GetInsertBlock();
-    loopVarValue->addIncoming(nextValue, loopEndBB);
-
-    auto *const afterLoopBB = llvm::BasicBlock::Create(*llvmContext,
-                                                       "after_loop",
-                                                       currFunction);
-    llvmIRBuilder->CreateCondBr(condExprValue, loopBB, afterLoopBB);
+    // exit
+    moveToEnd(afterLoopBB);
     llvmIRBuilder->SetInsertPoint(afterLoopBB);
 
     if (OldVar != nullptr) {
@@ -363,22 +681,445 @@ void IRCodegen::visit(const ForLoopNode *node) {
     } else {
         namedValues.erase(initVarAst->name);
     }
-    value_ = llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*llvmContext));
+    value_ = llvmIRBuilder->CreateLoad(resultVar->getAllocatedType(), resultVar, "loop_value");
+}
+
+void IRCodegen::generateParallelFor(const ForLoopNode *const node) {
+    const auto *const initVar = dynamic_cast<const VariableDefinitionStatement *>(node->init.get());
+    const auto *const condition = dynamic_cast<const BinOpNode *>(node->conditional.get());
+    const auto *const conditionVar = condition != nullptr
+                                         ? dynamic_cast<const VariableAccessNode *>(condition->lhs.get())
+                                         : nullptr;
+    if (initVar == nullptr || conditionVar == nullptr || conditionVar->name != initVar->name
+        || condition->binOp != TokenType::LeftAngleBracketToken) {
+        return;
+    }
+    // The bounds are computed once, before any iteration runs.
+    auto *const beginValue = generate(initVar->rvalue.get());
+    auto *const endValue = generate(condition->rhs.get());
+    if (beginValue == nullptr || endValue == nullptr) {
+        return;
+    }
+    std::vector<std::string> captured;
+    std::vector<llvm::Value *> fields;
+    if (!captureVariables(node->body, initVar->name, captured, fields)) {
+        return;
+    }
+    const bool generated = generateParallelCall(
+        "parfor", captured, fields, 0,
+        convert(beginValue, ValueType::Integer), convert(endValue, ValueType::Integer),
+        [this, node, initVar](llvm::Value *const rangeBegin, llvm::Value *const rangeEnd,
+                              const std::vector<llvm::Value *> &) {
+            return generateCountedLoop(rangeBegin, rangeEnd, initVar->name, [this, node](llvm::Value *) {
+                return generateBlock(node->body) != nullptr;
+            });
+        });
+    if (generated) {
+        value_ = llvmIRBuilder->getInt64(0);
+    }
+}
+
+void IRCodegen::visit(const ReductionNode *node) {
+    auto *const beginValue = generate(node->init->rvalue.get());
+    auto *const endValue = generate(node->end.get());
+    if (beginValue == nullptr || endValue == nullptr) {
+        return;
+    }
+    auto *const begin = convert(beginValue, ValueType::Integer);
+    auto *const end = convert(endValue, ValueType::Integer);
+    const auto type = typeOf(node);
+    value_ = node->parallel
+                 ? generateParallelReduction(node, begin, end, type)
+                 : generateReduction(node, begin, end, type);
+}
+
+llvm::Value *IRCodegen::generateReduction(const ReductionNode *const node,
+                                          llvm::Value *const begin,
+                                          llvm::Value *const end,
+                                          const ValueType type) {
+    auto *const function = llvmIRBuilder->GetInsertBlock()->getParent();
+    auto *const accumulator = createEntryBlockAlloca(function, toLLVMType(type), "reduction");
+    llvmIRBuilder->CreateStore(reductionIdentity(node->kind, toLLVMType(type)), accumulator);
+    const bool generated = generateCountedLoop(begin, end, node->init->name, [&](llvm::Value *) {
+        auto *const bodyValue = generateBlock(node->body);
+        if (bodyValue == nullptr) {
+            return false;
+        }
+        auto *const partial = llvmIRBuilder->CreateLoad(accumulator->getAllocatedType(), accumulator);
+        llvmIRBuilder->CreateStore(combineReduction(*llvmIRBuilder, node->kind, partial, convert(bodyValue, type)),
+                                   accumulator);
+        return true;
+    });
+    if (!generated) {
+        return nullptr;
+    }
+    return llvmIRBuilder->CreateLoad(accumulator->getAllocatedType(), accumulator, "reduction_value");
+}
+
+llvm::Value *IRCodegen::generateParallelReduction(const ReductionNode *const node,
+                                                  llvm::Value *const begin,
+                                                  llvm::Value *const end,
+                                                  const ValueType type) {
+    // Every chunk of the range reduces into its own slot, and the slots are combined in order afterward, so the
+    // result depends neither on the number of threads nor on the schedule.
+    constexpr std::uint64_t chunks = 256;
+    // Chunks are numbered under a name no variable of the script can have.
+    const std::string chunkName = "parreduce.chunk";
+    auto *const function = llvmIRBuilder->GetInsertBlock()->getParent();
+    auto *const partialsType = llvm::ArrayType::get(toLLVMType(type), chunks);
+    auto *const partials = createEntryBlockAlloca(function, partialsType, "partials");
+    auto *const count = llvmIRBuilder->CreateSelect(llvmIRBuilder->CreateICmpSLT(begin, end),
+                                                    llvmIRBuilder->CreateNSWSub(end, begin),
+                                                    llvmIRBuilder->getInt64(0), "count");
+    std::vector<std::string> captured;
+    std::vector<llvm::Value *> fields{partials, begin, count};
+    const auto leadingFields = fields.size();
+    if (!captureVariables(node->body, node->init->name, captured, fields)) {
+        return nullptr;
+    }
+    const bool generated = generateParallelCall(
+        "parreduce", captured, fields, leadingFields, llvmIRBuilder->getInt64(0), llvmIRBuilder->getInt64(chunks),
+        [&](llvm::Value *const rangeBegin, llvm::Value *const rangeEnd, const std::vector<llvm::Value *> &context) {
+            return generateCountedLoop(rangeBegin, rangeEnd, chunkName, [&](llvm::Value *const chunk) {
+                // Chunk c covers [begin + count * c / chunks, begin + count * (c + 1) / chunks).
+                const auto bound = [&](llvm::Value *const c) {
+                    auto *const offset = llvmIRBuilder->CreateUDiv(llvmIRBuilder->CreateNUWMul(context[2], c),
+                                                                   llvmIRBuilder->getInt64(chunks));
+                    return llvmIRBuilder->CreateNSWAdd(context[1], offset);
+                };
+                auto *const partial = generateReduction(
+                    node, bound(chunk), bound(llvmIRBuilder->CreateNUWAdd(chunk, llvmIRBuilder->getInt64(1))), type);
+                if (partial == nullptr) {
+                    return false;
+                }
+                llvmIRBuilder->CreateStore(partial, llvmIRBuilder->CreateInBoundsGEP(
+                                               partialsType, context[0], {llvmIRBuilder->getInt64(0), chunk}));
+                return true;
+            });
+        });
+    if (!generated) {
+        return nullptr;
+    }
+
+    auto *const accumulator = createEntryBlockAlloca(function, toLLVMType(type), "reduction");
+    llvmIRBuilder->CreateStore(reductionIdentity(node->kind, toLLVMType(type)), accumulator);
+    generateCountedLoop(llvmIRBuilder->getInt64(0), llvmIRBuilder->getInt64(chunks), chunkName,
+                        [&](llvm::Value *const chunk) {
+                            auto *const slot = llvmIRBuilder->CreateInBoundsGEP(
+                                partialsType, partials, {llvmIRBuilder->getInt64(0), chunk});
+                            auto *const partial = llvmIRBuilder->CreateLoad(toLLVMType(type), slot);
+                            auto *const reduced = llvmIRBuilder->CreateLoad(toLLVMType(type), accumulator);
+                            llvmIRBuilder->CreateStore(
+                                combineReduction(*llvmIRBuilder, node->kind, reduced, partial), accumulator);
+                            return true;
+                        });
+    return llvmIRBuilder->CreateLoad(accumulator->getAllocatedType(), accumulator, "reduction_value");
+}
+
+bool IRCodegen::generateCountedLoop(llvm::Value *const begin,
+                                    llvm::Value *const end,
+                                    const std::string &indexName,
+                                    const std::function<bool(llvm::Value *index)> &generateBody) {
+    auto *const function = llvmIRBuilder->GetInsertBlock()->getParent();
+    auto *const sizeType = llvmIRBuilder->getInt64Ty();
+    auto *const index = createEntryBlockAlloca(function, sizeType, indexName);
+    llvmIRBuilder->CreateStore(begin, index);
+    const auto outer = namedValues.find(indexName);
+    auto *const outerValue = outer != namedValues.end() ? outer->second : nullptr;
+    namedValues[indexName] = index;
+
+    // Rotated like the for loop, see visit(const ForLoopNode *).
+    auto *const preheaderBB = llvm::BasicBlock::Create(*llvmContext, "loop_preheader", function);
+    auto *const bodyBB = llvm::BasicBlock::Create(*llvmContext, "loop_body", function);
+    auto *const afterLoopBB = llvm::BasicBlock::Create(*llvmContext, "after_loop", function);
+    llvmIRBuilder->CreateCondBr(llvmIRBuilder->CreateICmpSLT(begin, end), preheaderBB, afterLoopBB);
+    llvmIRBuilder->SetInsertPoint(preheaderBB);
+    llvmIRBuilder->CreateBr(bodyBB);
+
+    llvmIRBuilder->SetInsertPoint(bodyBB);
+    const bool generated = generateBody(llvmIRBuilder->CreateLoad(sizeType, index, indexName));
+    if (outerValue != nullptr) {
+        namedValues[indexName] = outerValue;
+    } else {
+        namedValues.erase(indexName);
+    }
+    if (!generated) {
+        return false;
+    }
+    auto *const nextValue = llvmIRBuilder->CreateNSWAdd(llvmIRBuilder->CreateLoad(sizeType, index),
+                                                        llvmIRBuilder->getInt64(1), "next_var");
+    llvmIRBuilder->CreateStore(nextValue, index);
+    auto *const backEdge = llvmIRBuilder->CreateCondBr(llvmIRBuilder->CreateICmpSLT(nextValue, end), bodyBB,
+                                                       afterLoopBB);
+    backEdge->setMetadata(llvm::LLVMContext::MD_loop, createLoopID(*llvmContext));
+
+    moveToEnd(afterLoopBB);
+    llvmIRBuilder->SetInsertPoint(afterLoopBB);
+    return true;
+}
+
+bool IRCodegen::captureVariables(const std::list<std::unique_ptr<BaseNode> > &body,
+                                 const std::string &indexName,
+                                 std::vector<std::string> &captured,
+                                 std::vector<llvm::Value *> &fields) {
+    // Iterations may not assign the captured variables, nor the index; variables first assigned in the body are
+    // private to an iteration.
+    std::vector<std::string> read;
+    std::unordered_set<std::string> assigned;
+    collectVariables(body, read, assigned);
+    if (assigned.contains(indexName)) {
+        return false;
+    }
+    for (const auto &name: read) {
+        const auto variable = namedValues.find(name);
+        if (name == indexName || variable == namedValues.end()) {
+            continue;
+        }
+        if (assigned.contains(name)) {
+            return false;
+        }
+        captured.push_back(name);
+        if (auto *const alloca = llvm::dyn_cast<llvm::AllocaInst>(variable->second)) {
+            fields.push_back(llvmIRBuilder->CreateLoad(alloca->getAllocatedType(), alloca, name));
+        } else if (auto *const global = llvm::dyn_cast<llvm::GlobalVariable>(variable->second)) {
+            fields.push_back(llvmIRBuilder->CreateLoad(global->getValueType(), global, name));
+        } else {
+            fields.push_back(variable->second);
+            if (variable->second->getType()->isPointerTy()) {
+                fields.push_back(namedValues.at(lengthNameOf(name)));
+            }
+        }
+    }
+    return true;
+}
+
+bool IRCodegen::generateParallelCall(
+    const std::string &kind,
+    const std::vector<std::string> &captured,
+    const std::vector<llvm::Value *> &fields,
+    const std::size_t leadingFields,
+    llvm::Value *const begin,
+    llvm::Value *const end,
+    const std::function<bool(llvm::Value *, llvm::Value *, const std::vector<llvm::Value *> &)> &generateRange) {
+    auto *const function = llvmIRBuilder->GetInsertBlock()->getParent();
+    std::vector<llvm::Type *> fieldTypes;
+    for (auto *const field: fields) {
+        fieldTypes.push_back(field->getType());
+    }
+    auto *const contextType = llvm::StructType::get(*llvmContext, fieldTypes);
+    auto *const context = createEntryBlockAlloca(function, contextType, kind + "_context");
+    for (unsigned i = 0; i < fields.size(); ++i) {
+        llvmIRBuilder->CreateStore(fields[i], llvmIRBuilder->CreateStructGEP(contextType, context, i));
+    }
+
+    auto name = function->getName().str() + "." + kind;
+    for (unsigned i = 0;; ++i) {
+        if (llvmModule->getFunction(name + std::to_string(i)) == nullptr) {
+            name += std::to_string(i);
+            break;
+        }
+    }
+    auto *const sizeType = llvmIRBuilder->getInt64Ty();
+    auto *const bodyType = llvm::FunctionType::get(llvmIRBuilder->getVoidTy(),
+                                                   {llvmIRBuilder->getPtrTy(), sizeType, sizeType}, false);
+    auto *const body = llvm::Function::Create(bodyType, llvm::Function::ExternalLinkage, name, llvmModule.get());
+    body->addParamAttr(0, llvm::Attribute::NoAlias);
+    body->addParamAttr(0, llvm::Attribute::ReadOnly);
+    {
+        const llvm::IRBuilderBase::InsertPointGuard insertPointGuard(*llvmIRBuilder);
+        const auto outerValues = namedValues;
+        namedValues.clear();
+        llvmIRBuilder->SetInsertPoint(llvm::BasicBlock::Create(*llvmContext, "entry", body));
+        std::vector<llvm::Value *> loadedFields;
+        for (unsigned i = 0; i < fields.size(); ++i) {
+            auto *const address = llvmIRBuilder->CreateStructGEP(contextType, body->getArg(0), i);
+            loadedFields.push_back(llvmIRBuilder->CreateLoad(fieldTypes[i], address));
+        }
+        auto field = leadingFields;
+        for (const auto &capturedName: captured) {
+            const bool isArray = fieldTypes[field]->isPointerTy();
+            namedValues[capturedName] = loadedFields[field++];
+            if (isArray) {
+                namedValues[lengthNameOf(capturedName)] = loadedFields[field++];
+            }
+        }
+        const bool generated = generateRange(body->getArg(1), body->getArg(2), loadedFields);
+        namedValues = outerValues;
+        if (!generated) {
+            body->eraseFromParent();
+            return false;
+        }
+        llvmIRBuilder->CreateRetVoid();
+    }
+
+    const auto parallelFor = llvmModule->getOrInsertFunction(
+        parallelForSymbol,
+        llvm::FunctionType::get(llvmIRBuilder->getVoidTy(),
+                                {llvmIRBuilder->getPtrTy(), llvmIRBuilder->getPtrTy(), sizeType, sizeType}, false));
+    llvmIRBuilder->CreateCall(parallelFor, {body, context, begin, end});
+    return true;
 }
 
 void IRCodegen::visit(const UnaryOpNode *node) {
+    auto *operand = generate(node->expr.get());
+    if (operand == nullptr) {
+        return;
+    }
+    const bool isInteger = toValueType(operand->getType()) != ValueType::Double;
+    operand = convert(operand, isInteger ? ValueType::Integer : ValueType::Double);
+    auto *const one = isInteger
+                          ? static_cast<llvm::Value *>(llvmIRBuilder->getInt64(1))
+                          : llvm::ConstantFP::get(*llvmContext, llvm::APFloat(1.0));
     if (node->operatorType == TokenType::IncrementOperatorToken) {
-        value_ = llvmIRBuilder->CreateFAdd(generateIR(node->expr.get(),
-                                                      llvmContext, llvmIRBuilder, llvmModule, functionProtos,
-                                                      namedValues),
-                                           llvm::ConstantFP::get(*llvmContext, llvm::APFloat(1.0)), "increment");
+        value_ = isInteger
+                     ? llvmIRBuilder->CreateAdd(operand, one, "increment")
+                     : llvmIRBuilder->CreateFAdd(operand, one, "increment");
     } else if (node->operatorType == TokenType::DecrementOperatorToken) {
-        value_ = llvmIRBuilder->CreateFSub(
-            generateIR(node->expr.get(), llvmContext, llvmIRBuilder, llvmModule, functionProtos, namedValues),
-            llvm::ConstantFP::get(*llvmContext, llvm::APFloat(1.0)), "decrement");
+        value_ = isInteger
+                     ? llvmIRBuilder->CreateSub(operand, one, "decrement")
+                     : llvmIRBuilder->CreateFSub(operand, one, "decrement");
+    } else {
+        return;
+    }
+    // ++/-- applied to a variable updates it in place.
+    if (const auto *const var = dynamic_cast<const VariableAccessNode *>(node->expr.get())) {
+        if (const auto variable = namedValues.find(var->name); variable != namedValues.end()) {
+            if (auto *const alloca = llvm::dyn_cast<llvm::AllocaInst>(variable->second)) {
+                llvmIRBuilder->CreateStore(convert(value_, toValueType(alloca->getAllocatedType())), alloca);
+            } else if (auto *const global = llvm::dyn_cast<llvm::GlobalVariable>(variable->second)) {
+                llvmIRBuilder->CreateStore(convert(value_, ValueType::Double), global);
+            }
+        }
+    }
+}
+
+void IRCodegen::visit(const ArrayAccessNode *node) {
+    if (auto *const element = elementPointer(node->name, node->index.get())) {
+        value_ = llvmIRBuilder->CreateLoad(llvmIRBuilder->getDoubleTy(), element, node->name);
+    }
+}
+
+void IRCodegen::visit(const ArrayAssignmentStatement *node) {
+    auto *const element = elementPointer(node->name, node->index.get());
+    if (element == nullptr) {
+        return;
+    }
+    auto *const rvalue = generate(node->rvalue.get());
+    if (rvalue == nullptr) {
+        return;
     }
+    llvmIRBuilder->CreateStore(convert(rvalue, ValueType::Double), element);
+    value_ = rvalue;
 }
 
 llvm::Value *IRCodegen::value() const {
     return value_;
 }
+
+llvm::Value *IRCodegen::generate(const BaseNode *const node) const {
+    IRCodegen codegen(llvmContext, llvmIRBuilder, llvmModule, functionProtos, namedValues);
+    codegen.variableTypes = variableTypes;
+    node->visit(&codegen);
+    return codegen.value();
+}
+
+llvm::Value *IRCodegen::generateBlock(const std::list<std::unique_ptr<BaseNode> > &nodes) const {
+    for (auto it = nodes.begin(); it != nodes.end(); ++it) {
+        auto *const ir = generate(it->get());
+        if (*it == nodes.back() && ir != nullptr) {
+            return ir;
+        }
+    }
+    return nullptr;
+}
+
+llvm::Value *IRCodegen::elementPointer(const std::string &array, const ExpressionNode *const index) const {
+    // Scalars live in stack slots and globals, an array is bound to its pointer itself.
+    const auto pointer = namedValues.find(array);
+    if (pointer == namedValues.end() || llvm::isa<llvm::AllocaInst>(pointer->second)
+        || llvm::isa<llvm::GlobalVariable>(pointer->second) || !pointer->second->getType()->isPointerTy()) {
+        return nullptr;
+    }
+    auto *const indexValue = generate(index);
+    if (indexValue == nullptr) {
+        return nullptr;
+    }
+    return llvmIRBuilder->CreateInBoundsGEP(llvmIRBuilder->getDoubleTy(), pointer->second,
+                                            convert(indexValue, ValueType::Integer), array + "_element");
+}
+
+llvm::Function *IRCodegen::getFunction(const std::string &name) const {
+    // First, see if the function has already been added to the current module.
+    if (auto *const function = llvmModule->getFunction(name)) {
+        return function;
+    }
+
+    // If not, check whether we can codegen the declaration from some existing
+    // prototype.
+    if (const auto iterator = functionProtos.find(name); iterator != functionProtos.end()) {
+        return llvm::cast<llvm::Function>(generate(iterator->second.get()));
+    }
+
+    // If no existing prototype exists, return null.
+    return nullptr;
+}
+
+ValueType IRCodegen::typeOf(const BaseNode *const node) const {
+    if (variableTypes == nullptr) {
+        VariableTypes emptyTypes;
+        return inferType(node, emptyTypes);
+    }
+    return inferType(node, *variableTypes);
+}
+
+ValueType IRCodegen::typeOf(const std::string &name) const {
+    if (variableTypes == nullptr) {
+        return ValueType::Double;
+    }
+    const auto variable = variableTypes->find(name);
+    return variable != variableTypes->end() ? variable->second : ValueType::Double;
+}
+
+llvm::Type *IRCodegen::toLLVMType(const ValueType type) const {
+    switch (type) {
+        case ValueType::Boolean:
+            return llvmIRBuilder->getInt1Ty();
+        case ValueType::Integer:
+            return llvmIRBuilder->getInt64Ty();
+        case ValueType::Double:
+            break;
+    }
+    return llvmIRBuilder->getDoubleTy();
+}
+
+llvm::Value *IRCodegen::convert(llvm::Value *const value, const ValueType type) const {
+    const auto valueType = toValueType(value->getType());
+    if (valueType == type) {
+        return value;
+    }
+    switch (type) {
+        case ValueType::Boolean:
+            return toCondition(value, "to_bool");
+        case ValueType::Integer:
+            return valueType == ValueType::Boolean
+                       ? llvmIRBuilder->CreateZExt(value, llvmIRBuilder->getInt64Ty(), "to_int")
+                       : llvmIRBuilder->CreateFPToSI(value, llvmIRBuilder->getInt64Ty(), "to_int");
+        case ValueType::Double:
+            break;
+    }
+    return valueType == ValueType::Boolean
+               ? llvmIRBuilder->CreateUIToFP(value, llvmIRBuilder->getDoubleTy(), "to_double")
+               : llvmIRBuilder->CreateSIToFP(value, llvmIRBuilder->getDoubleTy(), "to_double");
+}
+
+llvm::Value *IRCodegen::toCondition(llvm::Value *const value, const llvm::Twine &name) const {
+    switch (toValueType(value->getType())) {
+        case ValueType::Boolean:
+            return value;
+        case ValueType::Integer:
+            return llvmIRBuilder->CreateICmpNE(value, llvmIRBuilder->getInt64(0), name);
+        case ValueType::Double:
+            break;
+    }
+    return llvmIRBuilder->CreateFCmpONE(value, llvm::ConstantFP::get(*llvmContext, llvm::APFloat(0.0)), name);
+}
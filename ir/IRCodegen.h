@@ -5,18 +5,27 @@
 #ifndef IRCODEGEN_H
 #define IRCODEGEN_H
 
+#include <functional>
+#include <list>
+#include <string>
+#include <vector>
+
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Intrinsics.h>
 #include <llvm/IR/Value.h>
 
 #include "ast/BaseNode.h"
+#include "TypeInference.h"
 
 class CallFunctionNode;
 class VariableDefinitionStatement;
 class ProtoFunctionStatement;
 class FunctionNode;
+class ForLoopNode;
 class BinOpNode;
 class NumberNode;
 class VariableAccessNode;
+class ReductionNode;
 
 class IRCodegen final : public NodeVisitor {
 public:
@@ -46,10 +55,80 @@ public:
 
     void visit(const UnaryOpNode *node) override;
 
+    void visit(const ArrayAccessNode *node) override;
+
+    void visit(const ArrayAssignmentStatement *node) override;
+
+    void visit(const ReductionNode *node) override;
+
     [[nodiscard]] llvm::Value *value() const;
 
 private:
+    [[nodiscard]] llvm::Value *generate(const BaseNode *node) const;
+
+    llvm::Value *generateBlock(const std::list<std::unique_ptr<BaseNode> > &nodes) const;
+
+    llvm::Function *getFunction(const std::string &name) const;
+
+    // Outlines the body of a parfor loop and runs it on the work-stealing pool of the runtime.
+    void generateParallelFor(const ForLoopNode *node);
+
+    // Reduces the body of the node over [begin, end) into a value of the given type.
+    llvm::Value *generateReduction(const ReductionNode *node, llvm::Value *begin, llvm::Value *end, ValueType type);
+
+    // Same as generateReduction(), split into chunks reduced on the work-stealing pool.
+    llvm::Value *generateParallelReduction(const ReductionNode *node,
+                                           llvm::Value *begin,
+                                           llvm::Value *end,
+                                           ValueType type);
+
+    // Generates for (index = begin; index < end; ++index) around generateBody, which gets the index; index is bound
+    // to indexName meanwhile. Fails when generateBody does.
+    bool generateCountedLoop(llvm::Value *begin,
+                             llvm::Value *end,
+                             const std::string &indexName,
+                             const std::function<bool(llvm::Value *index)> &generateBody);
+
+    // Appends the names of the variables of the enclosing function which the body reads to captured, and their
+    // values to fields; an array takes two fields, its pointer and its length. Fails when the body assigns one of
+    // them or the loop index.
+    bool captureVariables(const std::list<std::unique_ptr<BaseNode> > &body,
+                          const std::string &indexName,
+                          std::vector<std::string> &captured,
+                          std::vector<llvm::Value *> &fields);
+
+    // Passes fields in a context struct to void <function>.<kind>N(ptr context, i64 begin, i64 end) and runs it over
+    // [begin, end) on the work-stealing pool. Inside, the captured variables are bound to the fields following the
+    // first leadingFields ones, and generateRange generates the work of a range from the loaded fields.
+    bool generateParallelCall(const std::string &kind,
+                              const std::vector<std::string> &captured,
+                              const std::vector<llvm::Value *> &fields,
+                              std::size_t leadingFields,
+                              llvm::Value *begin,
+                              llvm::Value *end,
+                              const std::function<bool(llvm::Value *rangeBegin,
+                                                       llvm::Value *rangeEnd,
+                                                       const std::vector<llvm::Value *> &fields)> &generateRange);
+
+    // Address of array[index], null unless array names an array.
+    llvm::Value *elementPointer(const std::string &array, const ExpressionNode *index) const;
+
+    // Calls the double overload of the intrinsic with the arguments of the node.
+    void generateIntrinsicCall(llvm::Intrinsic::ID intrinsic, const CallFunctionNode *node);
+
+    [[nodiscard]] ValueType typeOf(const BaseNode *node) const;
+
+    [[nodiscard]] ValueType typeOf(const std::string &name) const;
+
+    [[nodiscard]] llvm::Type *toLLVMType(ValueType type) const;
+
+    llvm::Value *convert(llvm::Value *value, ValueType type) const;
+
+    llvm::Value *toCondition(llvm::Value *value, const llvm::Twine &name) const;
+
     llvm::Value * value_ = nullptr;
+    // Types of the locals of the function being generated, shared with the visitors of its nodes.
+    VariableTypes *variableTypes = nullptr;
     const std::unique_ptr<llvm::LLVMContext> &llvmContext;
     const std::unique_ptr<llvm::IRBuilder<> > &llvmIRBuilder;
     const std::unique_ptr<llvm::Module> &llvmModule;
@@ -57,6 +136,9 @@ private:
     std::unordered_map<std::string, llvm::Value *> &namedValues;
 };
 
+// Whether calls of name lower to an intrinsic or to len() of an array, unless a function of that name is declared.
+bool isBuiltinFunction(const std::string &name);
+
 inline llvm::Value *generateIR(const BaseNode *const node,
                                const std::unique_ptr<llvm::LLVMContext> &llvmContext,
                                const std::unique_ptr<llvm::IRBuilder<> > &llvmIRBuilder,
@@ -0,0 +1,64 @@
+#include "IROptimizer.h"
+
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/StandardInstrumentations.h"
+#include "llvm/Transforms/IPO/Internalize.h"
+
+namespace {
+    void runPipeline(llvm::Module &module,
+                     llvm::TargetMachine &targetMachine,
+                     const std::function<llvm::ModulePassManager(llvm::PassBuilder &)> &buildPipeline) {
+        llvm::LoopAnalysisManager loopAnalysisManager;
+        llvm::FunctionAnalysisManager functionAnalysisManager;
+        llvm::CGSCCAnalysisManager cgsccAnalysisManager;
+        llvm::ModuleAnalysisManager moduleAnalysisManager;
+        llvm::PassInstrumentationCallbacks passInstsCallbacks;
+        llvm::StandardInstrumentations standardInsts(module.getContext(), /*DebugLogging*/ false);
+        standardInsts.registerCallbacks(passInstsCallbacks, &moduleAnalysisManager);
+
+        llvm::PassBuilder passBuilder(&targetMachine, llvm::PipelineTuningOptions(), std::nullopt,
+                                      &passInstsCallbacks);
+        passBuilder.registerModuleAnalyses(moduleAnalysisManager);
+        passBuilder.registerCGSCCAnalyses(cgsccAnalysisManager);
+        passBuilder.registerFunctionAnalyses(functionAnalysisManager);
+        passBuilder.registerLoopAnalyses(loopAnalysisManager);
+        passBuilder.crossRegisterProxies(loopAnalysisManager,
+                                         functionAnalysisManager,
+                                         cgsccAnalysisManager,
+                                         moduleAnalysisManager);
+
+        auto modulePassManager = buildPipeline(passBuilder);
+        modulePassManager.run(module, moduleAnalysisManager);
+    }
+} // namespace
+
+void optimizeModule(llvm::Module &module, llvm::TargetMachine &targetMachine) {
+    runPipeline(module, targetMachine, [](llvm::PassBuilder &passBuilder) {
+        return passBuilder.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O2);
+    });
+}
+
+void optimizeWholeProgram(llvm::Module &module,
+                          llvm::TargetMachine &targetMachine,
+                          const std::function<bool(const llvm::GlobalValue &)> &isExported) {
+    llvm::internalizeModule(module, [&isExported](const llvm::GlobalValue &value) {
+        return isExported(value);
+    });
+    // Functions whose address escapes, e.g. parfor bodies handed to the runtime, keep the C calling convention.
+    for (auto &function: module) {
+        if (function.isDeclaration() || !function.hasLocalLinkage() || function.hasAddressTaken()) {
+            continue;
+        }
+        function.setCallingConv(llvm::CallingConv::Fast);
+        for (auto *const user: function.users()) {
+            llvm::cast<llvm::CallBase>(user)->setCallingConv(llvm::CallingConv::Fast);
+        }
+    }
+    runPipeline(module, targetMachine, [](llvm::PassBuilder &passBuilder) {
+        llvm::ModulePassManager modulePassManager;
+        llvm::cantFail(passBuilder.parsePassPipeline(modulePassManager, "ipsccp,cgscc(inline),globaldce"));
+        return modulePassManager;
+    });
+}
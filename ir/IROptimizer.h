@@ -0,0 +1,23 @@
+#ifndef IROPTIMIZER_H
+#define IROPTIMIZER_H
+
+#include <functional>
+
+#include "llvm/IR/GlobalValue.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Target/TargetMachine.h"
+
+// Runs the standard O2 pipeline: SROA/mem2reg, instcombine, GVN, LICM, IndVars, loop rotation, unrolling and
+// vectorization. The target machine gives the loop vectorizer and unroller the real cost model of the target.
+// All pass and analysis managers are local, so modules may be optimized concurrently as long as every thread passes
+// its own target machine.
+void optimizeModule(llvm::Module &module, llvm::TargetMachine &targetMachine);
+
+// Treats the module as the whole program: every definition for which isExported returns false becomes internal,
+// internal functions called directly only switch to fastcc, then IPSCCP, the inliner and GlobalDCE propagate
+// constants into callees, inline helpers and drop the functions left without callers.
+void optimizeWholeProgram(llvm::Module &module,
+                          llvm::TargetMachine &targetMachine,
+                          const std::function<bool(const llvm::GlobalValue &)> &isExported);
+
+#endif //IROPTIMIZER_H
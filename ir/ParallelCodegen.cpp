@@ -0,0 +1,122 @@
+#include "ParallelCodegen.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+
+#include "GlobalVariables.h"
+#include "IRCodegen.h"
+#include "PurityAnalysis.h"
+
+namespace {
+    // One module per function, as with sequential codegen, but all modules of a worker share its context.
+    std::vector<llvm::orc::ThreadSafeModule> generateWorkerModules(
+        const std::vector<const FunctionNode *> &functions,
+        std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > &functionProtos,
+        const llvm::DataLayout &dataLayout,
+        const std::string &targetTriple,
+        const std::unordered_set<std::string> &globals) {
+        auto llvmContext = std::make_unique<llvm::LLVMContext>();
+        const auto llvmIRBuilder = std::make_unique<llvm::IRBuilder<> >(*llvmContext);
+        std::unordered_map<std::string, llvm::Value *> namedValues;
+        std::vector<std::unique_ptr<llvm::Module> > llvmModules;
+        for (const auto *const function: functions) {
+            auto llvmModule = std::make_unique<llvm::Module>("my cool jit", *llvmContext);
+            llvmModule->setDataLayout(dataLayout);
+            llvmModule->setTargetTriple(targetTriple);
+            declareGlobals(*llvmModule, globals);
+            if (generateIR(function, llvmContext, llvmIRBuilder, llvmModule, functionProtos, namedValues) != nullptr) {
+                llvmModules.push_back(std::move(llvmModule));
+            }
+        }
+
+        const llvm::orc::ThreadSafeContext threadSafeContext(std::move(llvmContext));
+        std::vector<llvm::orc::ThreadSafeModule> modules;
+        for (auto &llvmModule: llvmModules) {
+            modules.emplace_back(std::move(llvmModule), threadSafeContext);
+        }
+        return modules;
+    }
+
+    void declarePrototypes(const std::vector<const FunctionNode *> &functions,
+                           std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > &functionProtos,
+                           const FastMath &defaultFastMath) {
+        for (const auto *const function: functions) {
+            auto proto = std::make_unique<ProtoFunctionStatement>(
+                function->proto->name, function->proto->args, false, function->proto->arrayArgs);
+            proto->fastMath = function->proto->fastMath.value_or(defaultFastMath);
+            functionProtos[function->proto->name] = std::move(proto);
+        }
+        inferPurity(functions, functionProtos);
+    }
+} // namespace
+
+std::vector<llvm::orc::ThreadSafeModule> generateModules(
+    const std::vector<const FunctionNode *> &functions,
+    std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > &functionProtos,
+    const llvm::DataLayout &dataLayout,
+    const std::string &targetTriple,
+    const unsigned threads,
+    const FastMath &defaultFastMath,
+    const std::unordered_set<std::string> &globals) {
+    declarePrototypes(functions, functionProtos, defaultFastMath);
+    if (functions.empty()) {
+        return {};
+    }
+
+    // Contiguous partitions keep the modules in source order.
+    const auto partitions = std::clamp<std::size_t>(threads, 1, functions.size());
+    const auto partitionSize = (functions.size() + partitions - 1) / partitions;
+    std::vector<std::vector<const FunctionNode *> > partitionFunctions;
+    for (std::size_t begin = 0; begin < functions.size(); begin += partitionSize) {
+        const auto end = std::min(begin + partitionSize, functions.size());
+        partitionFunctions.emplace_back(functions.begin() + begin, functions.begin() + end);
+    }
+
+    std::vector<std::vector<llvm::orc::ThreadSafeModule> > workerModules(partitionFunctions.size());
+    if (partitionFunctions.size() == 1) {
+        workerModules.front() = generateWorkerModules(partitionFunctions.front(), functionProtos, dataLayout,
+                                                      targetTriple, globals);
+    } else {
+        llvm::ThreadPool threadPool(llvm::hardware_concurrency(partitionFunctions.size()));
+        for (std::size_t i = 0; i < partitionFunctions.size(); ++i) {
+            threadPool.async([&, i] {
+                workerModules[i] = generateWorkerModules(partitionFunctions[i], functionProtos, dataLayout,
+                                                         targetTriple, globals);
+            });
+        }
+        threadPool.wait();
+    }
+
+    std::vector<llvm::orc::ThreadSafeModule> modules;
+    for (auto &partition: workerModules) {
+        std::move(partition.begin(), partition.end(), std::back_inserter(modules));
+    }
+    return modules;
+}
+
+llvm::orc::ThreadSafeModule generateModule(
+    const std::vector<const FunctionNode *> &functions,
+    std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > &functionProtos,
+    const llvm::DataLayout &dataLayout,
+    const std::string &targetTriple,
+    const FastMath &defaultFastMath,
+    const std::unordered_set<std::string> &globals) {
+    declarePrototypes(functions, functionProtos, defaultFastMath);
+    auto llvmContext = std::make_unique<llvm::LLVMContext>();
+    const auto llvmIRBuilder = std::make_unique<llvm::IRBuilder<> >(*llvmContext);
+    std::unordered_map<std::string, llvm::Value *> namedValues;
+    auto llvmModule = std::make_unique<llvm::Module>("my cool jit", *llvmContext);
+    llvmModule->setDataLayout(dataLayout);
+    llvmModule->setTargetTriple(targetTriple);
+    declareGlobals(*llvmModule, globals);
+    for (const auto *const function: functions) {
+        generateIR(function, llvmContext, llvmIRBuilder, llvmModule, functionProtos, namedValues);
+    }
+    return {std::move(llvmModule), std::move(llvmContext)};
+}
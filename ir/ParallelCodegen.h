@@ -0,0 +1,41 @@
+#ifndef PARALLELCODEGEN_H
+#define PARALLELCODEGEN_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/IR/DataLayout.h"
+
+#include "ast/FunctionNode.h"
+
+// Generates a module per function on up to `threads` worker threads, in the order of the functions. Every worker owns
+// a context and a builder, so modules of different workers may be compiled in parallel. Functions which fail to
+// generate are skipped.
+// The prototypes of all functions are registered in functionProtos before the workers start, with the purity inferred
+// by inferPurity(); the workers only read the map, so calls between the functions resolve to declarations regardless
+// of which worker generates the callee. Functions without fast-math flags of their own get defaultFastMath. Every
+// module declares the globals, see GlobalVariables.h.
+std::vector<llvm::orc::ThreadSafeModule> generateModules(
+    const std::vector<const FunctionNode *> &functions,
+    std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > &functionProtos,
+    const llvm::DataLayout &dataLayout,
+    const std::string &targetTriple,
+    unsigned threads,
+    const FastMath &defaultFastMath = {},
+    const std::unordered_set<std::string> &globals = {});
+
+// Generates all functions into a single module on the calling thread, so that calls between them can be optimized
+// across functions, see optimizeWholeProgram(). Functions which fail to generate are skipped.
+llvm::orc::ThreadSafeModule generateModule(
+    const std::vector<const FunctionNode *> &functions,
+    std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > &functionProtos,
+    const llvm::DataLayout &dataLayout,
+    const std::string &targetTriple,
+    const FastMath &defaultFastMath = {},
+    const std::unordered_set<std::string> &globals = {});
+
+#endif //PARALLELCODEGEN_H
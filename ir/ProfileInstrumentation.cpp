@@ -0,0 +1,103 @@
+#include "ProfileInstrumentation.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/ProfileSummary.h"
+#include "llvm/ProfileData/ProfileCommon.h"
+
+namespace {
+    std::vector<llvm::BranchInst *> conditionalBranchesOf(llvm::Function &function) {
+        std::vector<llvm::BranchInst *> branches;
+        for (auto &block: function) {
+            if (auto *const branch = llvm::dyn_cast<llvm::BranchInst>(block.getTerminator());
+                branch != nullptr && branch->isConditional()) {
+                branches.push_back(branch);
+            }
+        }
+        return branches;
+    }
+
+    void increment(llvm::IRBuilder<> &builder, llvm::GlobalVariable *const counters, const std::size_t index,
+                   llvm::Value *const amount) {
+        auto *const counter = builder.CreateConstInBoundsGEP2_64(counters->getValueType(), counters, 0, index);
+        auto *const value = builder.CreateAlignedLoad(builder.getInt64Ty(), counter, llvm::Align(8));
+        builder.CreateAlignedStore(builder.CreateAdd(value, amount), counter, llvm::Align(8));
+    }
+} // namespace
+
+std::size_t countersOf(const llvm::Function &function) {
+    std::size_t branches = 0;
+    for (const auto &block: function) {
+        if (const auto *const branch = llvm::dyn_cast<llvm::BranchInst>(block.getTerminator());
+            branch != nullptr && branch->isConditional()) {
+            ++branches;
+        }
+    }
+    return function.size() + branches;
+}
+
+void instrumentFunction(llvm::Function &function, const std::string &countersName) {
+    auto &module = *function.getParent();
+    auto *const countersType = llvm::ArrayType::get(llvm::Type::getInt64Ty(module.getContext()),
+                                                    countersOf(function));
+    auto *const counters = new llvm::GlobalVariable(module, countersType, false, llvm::GlobalValue::ExternalLinkage,
+                                                    nullptr, countersName);
+    const auto branches = conditionalBranchesOf(function);
+    // The counters are memory a pure function doesn't touch.
+    function.setMemoryEffects(llvm::MemoryEffects::unknown());
+    function.removeFnAttr(llvm::Attribute::Speculatable);
+
+    std::size_t index = 0;
+    for (auto &block: function) {
+        llvm::IRBuilder<> builder(&*block.getFirstInsertionPt());
+        increment(builder, counters, index++, builder.getInt64(1));
+    }
+    for (auto *const branch: branches) {
+        llvm::IRBuilder<> builder(branch);
+        increment(builder, counters, index++, builder.CreateZExt(branch->getCondition(), builder.getInt64Ty()));
+    }
+}
+
+void applyProfile(llvm::Function &function, const llvm::ArrayRef<std::uint64_t> counters) {
+    if (counters.size() != countersOf(function)) {
+        return;
+    }
+    function.setEntryCount(llvm::Function::ProfileCount(counters.front(), llvm::Function::PCT_Real));
+
+    const auto blockCounters = counters.take_front(function.size());
+    const auto branchCounters = counters.drop_front(function.size());
+    llvm::MDBuilder mdBuilder(function.getContext());
+    std::size_t blockIndex = 0;
+    std::size_t branchIndex = 0;
+    for (auto &block: function) {
+        const auto blockCount = blockCounters[blockIndex++];
+        auto *const branch = llvm::dyn_cast<llvm::BranchInst>(block.getTerminator());
+        if (branch == nullptr || !branch->isConditional()) {
+            continue;
+        }
+        const auto taken = std::min(branchCounters[branchIndex++], blockCount);
+        const auto notTaken = blockCount - taken;
+        // Weights are 32-bit, only their ratio matters.
+        const auto scale = std::max(taken, notTaken) / std::numeric_limits<std::uint32_t>::max() + 1;
+        branch->setMetadata(llvm::LLVMContext::MD_prof,
+                            mdBuilder.createBranchWeights(static_cast<std::uint32_t>(taken / scale),
+                                                          static_cast<std::uint32_t>(notTaken / scale)));
+    }
+
+    // Without a summary ProfileSummaryInfo treats no code as hot or cold, and the inliner and the size heuristics of
+    // the loop passes ignore the counts.
+    llvm::InstrProfSummaryBuilder summaryBuilder(llvm::ProfileSummaryBuilder::DefaultCutoffs.vec());
+    summaryBuilder.addEntryCount(blockCounters.front());
+    for (const auto count: blockCounters.drop_front()) {
+        summaryBuilder.addInternalCount(count);
+    }
+    auto &module = *function.getParent();
+    module.setProfileSummary(summaryBuilder.getSummary()->getMD(module.getContext()),
+                             llvm::ProfileSummary::PSK_Instr);
+}
@@ -0,0 +1,28 @@
+#ifndef PROFILEINSTRUMENTATION_H
+#define PROFILEINSTRUMENTATION_H
+
+#include <cstdint>
+#include <string>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/IR/Function.h"
+
+// Counters of an instrumented function: one per basic block in function order, then one per conditional branch in
+// the same order, counting how often its condition was true. The first counter is the number of calls.
+// Instrumentation adds no blocks, so the counters map onto the blocks of the function as IRCodegen emitted it.
+
+// Number of counters the function needs.
+std::size_t countersOf(const llvm::Function &function);
+
+// Increments the counters in an external [N x i64] array named countersName. Increments are plain loads and stores;
+// the counters are only read while no JIT code runs, and lost updates of racing threads only blur the profile.
+// The function loses the attributes of a pure function; callers which still see them may merge calls, which blurs
+// the profile the same way.
+void instrumentFunction(llvm::Function &function, const std::string &countersName);
+
+// Attaches the counters collected from the instrumented copy of the function to the uninstrumented one: the entry
+// count, branch weights on every conditional branch and a profile summary of the module, so that block layout,
+// if-conversion, loop unrolling and the inliner see the real hot paths instead of static heuristics.
+void applyProfile(llvm::Function &function, llvm::ArrayRef<std::uint64_t> counters);
+
+#endif //PROFILEINSTRUMENTATION_H
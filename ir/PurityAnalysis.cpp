@@ -0,0 +1,126 @@
+#include "PurityAnalysis.h"
+
+#include <algorithm>
+#include <iterator>
+#include <unordered_set>
+
+#include "AstWalk.h"
+#include "IRCodegen.h"
+#include "ast/CallFunctionNode.h"
+#include "ast/ForLoopNode.h"
+#include "ast/ReductionNode.h"
+
+namespace {
+    struct FunctionFacts {
+        std::vector<std::string> callees;
+        // Reads or writes memory of the caller, or runs code on other threads.
+        bool accessesMemory = false;
+        bool hasForLoop = false;
+    };
+
+    FunctionFacts factsOf(const FunctionNode *const function) {
+        FunctionFacts facts;
+        for (std::size_t i = 0; i < function->proto->args.size(); ++i) {
+            facts.accessesMemory |= function->proto->isArray(i);
+        }
+        // Top-level expressions write globals. A def reads one through every variable it neither takes nor assigns.
+        std::vector<std::string> read;
+        std::unordered_set<std::string> assigned;
+        collectVariables(function->body, read, assigned);
+        assigned.insert(function->proto->args.begin(), function->proto->args.end());
+        facts.accessesMemory |= function->proto->topLevel
+                || std::any_of(read.begin(), read.end(), [&assigned](const std::string &name) {
+                    return !assigned.contains(name);
+                });
+        walk(function->body, [&facts](const BaseNode *const node) {
+            if (const auto *const call = dynamic_cast<const CallFunctionNode *>(node)) {
+                facts.callees.push_back(call->callee);
+            } else if (const auto *const loop = dynamic_cast<const ForLoopNode *>(node)) {
+                facts.hasForLoop = true;
+                facts.accessesMemory |= loop->parallel;
+            } else if (const auto *const reduction = dynamic_cast<const ReductionNode *>(node)) {
+                facts.accessesMemory |= reduction->parallel;
+            }
+        });
+        return facts;
+    }
+} // namespace
+
+void inferPurity(const std::vector<const FunctionNode *> &functions,
+                 std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > &functionProtos) {
+    std::unordered_map<std::string, FunctionFacts> facts;
+    for (const auto *const function: functions) {
+        facts[function->proto->name] = factsOf(function);
+    }
+    // Calls resolve like in IRCodegen: a function of the list, then a prototype, then a builtin.
+    const auto calleeHas = [&](const std::string &callee,
+                               const std::unordered_set<std::string> &functionsWithProperty,
+                               bool ProtoFunctionStatement::*const property) {
+        if (facts.contains(callee)) {
+            return functionsWithProperty.contains(callee);
+        }
+        if (const auto proto = functionProtos.find(callee); proto != functionProtos.end()) {
+            return (*proto->second).*property;
+        }
+        return isBuiltinFunction(callee);
+    };
+
+    // Greatest fixed point: start from every candidate and drop the defs calling an impure function until none is
+    // left, so that recursive pure defs stay pure.
+    std::unordered_set<std::string> pure;
+    for (const auto &[name, functionFacts]: facts) {
+        if (!functionFacts.accessesMemory) {
+            pure.insert(name);
+        }
+    }
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (auto it = pure.begin(); it != pure.end();) {
+            const auto &callees = facts.at(*it).callees;
+            if (std::all_of(callees.begin(), callees.end(), [&](const std::string &callee) {
+                return calleeHas(callee, pure, &ProtoFunctionStatement::pure);
+            })) {
+                ++it;
+            } else {
+                it = pure.erase(it);
+                changed = true;
+            }
+        }
+    }
+
+    // Least fixed points: add the candidates whose callees all have the property, so that recursion never qualifies.
+    const auto leastFixedPoint = [&](const std::unordered_set<std::string> &candidates,
+                                     bool ProtoFunctionStatement::*const property) {
+        std::unordered_set<std::string> result;
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (const auto &name: candidates) {
+                if (result.contains(name)) {
+                    continue;
+                }
+                const auto &callees = facts.at(name).callees;
+                if (std::all_of(callees.begin(), callees.end(), [&](const std::string &callee) {
+                    return calleeHas(callee, result, property);
+                })) {
+                    result.insert(name);
+                    changed = true;
+                }
+            }
+        }
+        return result;
+    };
+    std::unordered_set<std::string> loopFree;
+    std::copy_if(pure.begin(), pure.end(), std::inserter(loopFree, loopFree.end()), [&](const std::string &name) {
+        return !facts.at(name).hasForLoop;
+    });
+    const auto willReturn = leastFixedPoint(loopFree, &ProtoFunctionStatement::willReturn);
+    const auto speculatable = leastFixedPoint(willReturn, &ProtoFunctionStatement::speculatable);
+
+    for (const auto *const function: functions) {
+        if (const auto proto = functionProtos.find(function->proto->name); proto != functionProtos.end()) {
+            proto->second->pure = pure.contains(function->proto->name);
+            proto->second->willReturn = willReturn.contains(function->proto->name);
+            proto->second->speculatable = speculatable.contains(function->proto->name);
+        }
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef PURITYANALYSIS_H
+#define PURITYANALYSIS_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ast/FunctionNode.h"
+#include "ast/ProtoFunctionStatement.h"
+
+// Sets pure, willReturn and speculatable on the registered prototypes of the functions, from their bodies and the call
+// graph. A def is pure unless it takes arrays, reads globals, runs parfor or a parallel reduction, or calls an impure
+// function such as print, directly or through other defs; pure defs may call each other recursively and loop. Only
+// pure defs without a for loop and recursion, which might not terminate for some args, are known to return; calls of
+// the others may not be removed even when unused. A def which returns is also speculatable when it calls no host
+// function.
+// Prototypes of functions outside the list, e.g. host functions and defs compiled earlier, are read only.
+void inferPurity(const std::vector<const FunctionNode *> &functions,
+                 std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > &functionProtos);
+
+#endif //PURITYANALYSIS_H
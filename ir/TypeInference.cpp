@@ -0,0 +1,167 @@
+#include "TypeInference.h"
+
+#include <algorithm>
+
+#include "ast/BinOpNode.h"
+#include "ast/ArrayAccessNode.h"
+#include "ast/ArrayAssignmentStatement.h"
+#include "ast/CallFunctionNode.h"
+#include "ast/ForLoopNode.h"
+#include "ast/FunctionNode.h"
+#include "ast/IfStatement.h"
+#include "ast/NumberNode.h"
+#include "ast/ReductionNode.h"
+#include "ast/UnaryOpNode.h"
+#include "ast/VariableAccessNode.h"
+#include "ast/VariableDefinitionStatement.h"
+
+namespace {
+    ValueType inferBlockType(const std::list<std::unique_ptr<BaseNode> > &nodes, VariableTypes &variableTypes) {
+        auto type = ValueType::Boolean;
+        for (const auto &node: nodes) {
+            type = inferType(node.get(), variableTypes);
+        }
+        return type;
+    }
+} // namespace
+
+ValueType join(const ValueType lhs, const ValueType rhs) {
+    return std::max(lhs, rhs);
+}
+
+TypeInference::TypeInference(VariableTypes &variableTypes) : variableTypes(variableTypes) {
+}
+
+void TypeInference::visit(const VariableAccessNode *node) {
+    const auto variable = variableTypes.find(node->name);
+    type_ = variable != variableTypes.end() ? variable->second : ValueType::Boolean;
+}
+
+void TypeInference::visit(const NumberNode *node) {
+    type_ = node->isInteger ? ValueType::Integer : ValueType::Double;
+}
+
+void TypeInference::visit(const BinOpNode *node) {
+    const auto lhsType = inferType(node->lhs.get(), variableTypes);
+    const auto rhsType = inferType(node->rhs.get(), variableTypes);
+    switch (node->binOp) {
+        case TokenType::LeftAngleBracketToken:
+        case TokenType::RightAngleBracketToken:
+            type_ = ValueType::Boolean;
+            break;
+        case TokenType::DivideToken:
+        case TokenType::MultiplyToken:
+            // Division keeps its real-valued meaning: 3 / 2 is 1.5. Products of integers outgrow 64 bits quickly,
+            // in double precision they only lose digits.
+            type_ = ValueType::Double;
+            break;
+        default:
+            type_ = join(join(lhsType, rhsType), ValueType::Integer);
+            break;
+    }
+}
+
+void TypeInference::visit(const FunctionNode *node) {
+    inferBlockType(node->body, variableTypes);
+    type_ = ValueType::Double;
+}
+
+void TypeInference::visit(const ProtoFunctionStatement *node) {
+    type_ = ValueType::Double;
+}
+
+void TypeInference::visit(const VariableDefinitionStatement *node) {
+    type_ = inferType(node->rvalue.get(), variableTypes);
+    // A variable may accumulate, so an integer value makes it a Double; only the induction variables of loops, see
+    // visit(const ForLoopNode *), are Integer.
+    assign(node->name, type_ == ValueType::Integer ? ValueType::Double : type_);
+}
+
+void TypeInference::visit(const CallFunctionNode *node) {
+    for (const auto &arg: node->args) {
+        inferType(arg.get(), variableTypes);
+    }
+    // Lengths of arrays are integers, every other call returns a double.
+    type_ = node->callee == "len" ? ValueType::Integer : ValueType::Double;
+}
+
+void TypeInference::visit(const IfStatement *node) {
+    inferType(node->cond.get(), variableTypes);
+    const auto thenType = inferBlockType(node->thenBranch, variableTypes);
+    const auto elseType = node->elseBranch.has_value()
+                              ? inferBlockType(node->elseBranch.value(), variableTypes)
+                              : ValueType::Boolean;
+    type_ = join(thenType, elseType);
+}
+
+void TypeInference::visit(const ForLoopNode *node) {
+    const auto *const initVar = dynamic_cast<const VariableDefinitionStatement *>(node->init.get());
+    if (initVar != nullptr) {
+        assign(initVar->name, inferType(initVar->rvalue.get(), variableTypes));
+    } else {
+        inferType(node->init.get(), variableTypes);
+    }
+    inferType(node->conditional.get(), variableTypes);
+    const auto bodyType = inferBlockType(node->body, variableTypes);
+    if (initVar != nullptr) {
+        const auto nextType = node->next ? inferType(node->next.get(), variableTypes) : ValueType::Integer;
+        assign(initVar->name, nextType);
+    }
+    // The loop evaluates to 0 when the body never runs; a parallel loop always does.
+    type_ = node->parallel ? ValueType::Integer : join(bodyType, ValueType::Integer);
+}
+
+void TypeInference::visit(const UnaryOpNode *node) {
+    type_ = join(inferType(node->expr.get(), variableTypes), ValueType::Integer);
+    if (const auto *const var = dynamic_cast<const VariableAccessNode *>(node->expr.get())) {
+        assign(var->name, type_);
+    }
+}
+
+void TypeInference::visit(const ArrayAccessNode *node) {
+    inferType(node->index.get(), variableTypes);
+    type_ = ValueType::Double;
+}
+
+void TypeInference::visit(const ArrayAssignmentStatement *node) {
+    inferType(node->index.get(), variableTypes);
+    type_ = inferType(node->rvalue.get(), variableTypes);
+}
+
+void TypeInference::visit(const ReductionNode *node) {
+    inferType(node->init->rvalue.get(), variableTypes);
+    inferType(node->end.get(), variableTypes);
+    assign(node->init->name, ValueType::Integer);
+    inferBlockType(node->body, variableTypes);
+    type_ = ValueType::Double;
+}
+
+ValueType TypeInference::type() const {
+    return type_;
+}
+
+void TypeInference::assign(const std::string &name, const ValueType type) {
+    const auto [variable, inserted] = variableTypes.try_emplace(name, type);
+    if (!inserted) {
+        variable->second = join(variable->second, type);
+    }
+}
+
+VariableTypes inferVariableTypes(const FunctionNode *const node, const std::vector<std::string> &globals) {
+    VariableTypes variableTypes;
+    for (const auto &global: globals) {
+        variableTypes[global] = ValueType::Double;
+    }
+    for (std::size_t i = 0; i < node->proto->args.size(); ++i) {
+        if (!node->proto->isArray(i)) {
+            variableTypes[node->proto->args[i]] = ValueType::Double;
+        }
+    }
+    // Types only grow, so this reaches a fixed point after at most two widenings per variable.
+    VariableTypes previousTypes;
+    do {
+        previousTypes = variableTypes;
+        inferBlockType(node->body, variableTypes);
+    } while (previousTypes != variableTypes);
+    return variableTypes;
+}
@@ -0,0 +1,76 @@
+#ifndef TYPEINFERENCE_H
+#define TYPEINFERENCE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ast/BaseNode.h"
+
+enum class ValueType : std::uint8_t {
+    Boolean,
+    Integer,
+    Double,
+};
+
+using VariableTypes = std::unordered_map<std::string, ValueType>;
+
+// The narrowest type both types convert to without loss: Boolean < Integer < Double.
+ValueType join(ValueType lhs, ValueType rhs);
+
+// Computes the type of an expression and widens the recorded type of every variable assigned inside it.
+// Variables which weren't assigned yet are assumed to be Boolean, the bottom of the lattice.
+class TypeInference final : public NodeVisitor {
+public:
+    explicit TypeInference(VariableTypes &variableTypes);
+
+    void visit(const VariableAccessNode *node) override;
+
+    void visit(const NumberNode *node) override;
+
+    void visit(const BinOpNode *node) override;
+
+    void visit(const FunctionNode *node) override;
+
+    void visit(const ProtoFunctionStatement *node) override;
+
+    void visit(const VariableDefinitionStatement *node) override;
+
+    void visit(const CallFunctionNode *node) override;
+
+    void visit(const IfStatement *node) override;
+
+    void visit(const ForLoopNode *node) override;
+
+    void visit(const UnaryOpNode *node) override;
+
+    void visit(const ArrayAccessNode *node) override;
+
+    void visit(const ArrayAssignmentStatement *node) override;
+
+    void visit(const ReductionNode *node) override;
+
+    [[nodiscard]] ValueType type() const;
+
+private:
+    void assign(const std::string &name, ValueType type);
+
+    ValueType type_ = ValueType::Boolean;
+    VariableTypes &variableTypes;
+};
+
+inline ValueType inferType(const BaseNode *const node, VariableTypes &variableTypes) {
+    TypeInference inference(variableTypes);
+    node->visit(&inference);
+    return inference.type();
+}
+
+// Local inference over a function body. Scalar parameters, the globals visible in the body and the return value stay
+// Double, so the calling convention and the globals don't depend on the body; every local gets the join of all values
+// assigned to it, where an integer value counts as Double. Only the induction variables of loops are Integer, so that
+// integers appear only in loop indices, len() and sums and differences of those and literals; they wrap around on
+// overflow like the i64 they are.
+VariableTypes inferVariableTypes(const FunctionNode *node, const std::vector<std::string> &globals = {});
+
+#endif //TYPEINFERENCE_H
@@ -0,0 +1,56 @@
+#include "CachedIRCompiler.h"
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+
+namespace llvm::orc {
+
+    namespace {
+        std::atomic<std::uint64_t> nextCompilerId{0};
+
+        // Keyed by compiler id rather than by address, so that a compiler allocated at the address of a destroyed
+        // one never picks up a target machine built for different options. Entries of destroyed compilers live until
+        // their thread exits.
+        thread_local std::unordered_map<std::uint64_t, std::unique_ptr<TargetMachine> > targetMachines;
+    } // namespace
+
+    CachedIRCompiler::CachedIRCompiler(JITTargetMachineBuilder targetMachineBuilder, ObjectCache *const objectCache)
+            : IRCompiler(irManglingOptionsFromTargetOptions(targetMachineBuilder.getOptions())),
+              targetMachineBuilder(std::move(targetMachineBuilder)),
+              objectCache(objectCache),
+              id(nextCompilerId.fetch_add(1, std::memory_order_relaxed)) {
+    }
+
+    Expected<std::unique_ptr<MemoryBuffer> > CachedIRCompiler::operator()(Module &module) {
+        auto targetMachine = getTargetMachine();
+        if (!targetMachine) {
+            return targetMachine.takeError();
+        }
+        const auto start = std::chrono::steady_clock::now();
+        auto objectFile = SimpleCompiler(*targetMachine, objectCache)(module);
+        compileNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        return objectFile;
+    }
+
+    Expected<TargetMachine &> CachedIRCompiler::getTargetMachine() {
+        auto &targetMachine = targetMachines[id];
+        if (targetMachine == nullptr) {
+            auto newTargetMachine = targetMachineBuilder.createTargetMachine();
+            if (!newTargetMachine) {
+                targetMachines.erase(id);
+                return newTargetMachine.takeError();
+            }
+            targetMachine = std::move(*newTargetMachine);
+        }
+        return *targetMachine;
+    }
+
+    std::chrono::nanoseconds CachedIRCompiler::getCompileTime() const {
+        return std::chrono::nanoseconds(compileNanoseconds.load());
+    }
+
+} // namespace llvm::orc
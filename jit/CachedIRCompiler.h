@@ -0,0 +1,41 @@
+#ifndef CACHEDIRCOMPILER_H
+#define CACHEDIRCOMPILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Target/TargetMachine.h"
+
+namespace llvm::orc {
+
+    // Drop-in replacement for ConcurrentIRCompiler. Instead of building a new TargetMachine for every module, each
+    // thread builds one on its first compilation and reuses it afterwards. A TargetMachine is never shared between
+    // threads, so the compiler may be called concurrently just like ConcurrentIRCompiler.
+    class CachedIRCompiler final : public IRCompileLayer::IRCompiler {
+    public:
+        explicit CachedIRCompiler(JITTargetMachineBuilder targetMachineBuilder, ObjectCache *objectCache = nullptr);
+
+        Expected<std::unique_ptr<MemoryBuffer> > operator()(Module &module) override;
+
+        // Target machine of the calling thread, created on first use.
+        Expected<TargetMachine &> getTargetMachine();
+
+        // Time spent in codegen by all threads.
+        [[nodiscard]] std::chrono::nanoseconds getCompileTime() const;
+
+    private:
+        JITTargetMachineBuilder targetMachineBuilder;
+        ObjectCache *objectCache;
+        const std::uint64_t id;
+        std::atomic<std::int64_t> compileNanoseconds{0};
+    };
+
+} // namespace llvm::orc
+
+#endif //CACHEDIRCOMPILER_H
@@ -0,0 +1,184 @@
+#include "FunctionEvictionManager.h"
+
+#include <algorithm>
+#include <tuple>
+#include <vector>
+
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace llvm::orc {
+
+    namespace {
+        constexpr auto bodySuffix = ".body";
+        constexpr auto callsSuffix = ".calls";
+
+        // Counts the calls of the function in an external counter. Relaxed atomics compile to plain loads and stores;
+        // increments lost to racing threads only blur the heuristic.
+        void countCalls(llvm::Function &function, const std::string &counterName) {
+            auto &module = *function.getParent();
+            auto *const int64Type = Type::getInt64Ty(module.getContext());
+            auto *const counter = new GlobalVariable(module, int64Type, false, GlobalValue::ExternalLinkage, nullptr,
+                                                     counterName);
+            IRBuilder<> builder(&*function.getEntryBlock().getFirstInsertionPt());
+            auto *const calls = builder.CreateAlignedLoad(int64Type, counter, Align(8));
+            calls->setAtomic(AtomicOrdering::Monotonic);
+            auto *const store = builder.CreateAlignedStore(builder.CreateAdd(calls, builder.getInt64(1)), counter,
+                                                           Align(8));
+            store->setAtomic(AtomicOrdering::Monotonic);
+        }
+    } // namespace
+
+    // Adds a body to the bodies JITDylib when a call-through looks it up.
+    class FunctionEvictionManager::BodyGenerator final : public DefinitionGenerator {
+    public:
+        explicit BodyGenerator(FunctionEvictionManager &manager) : manager(manager) {
+        }
+
+        Error tryToGenerate(LookupState &, LookupKind, JITDylib &, JITDylibLookupFlags,
+                            const SymbolLookupSet &lookupSet) override {
+            for (const auto &[name, flags]: lookupSet) {
+                if (auto error = manager.materializeBody(name)) {
+                    return error;
+                }
+            }
+            return Error::success();
+        }
+
+    private:
+        FunctionEvictionManager &manager;
+    };
+
+    FunctionEvictionManager::FunctionEvictionManager(ExecutionSession &executionSession,
+                                                     IRLayer &baseLayer,
+                                                     JITDylib &mainLib,
+                                                     MangleAndInterner &mangle,
+                                                     LazyCallThroughManager &lazyCallThroughManager,
+                                                     std::unique_ptr<IndirectStubsManager> stubsManager,
+                                                     const SlabMemoryMapper &memoryMapper,
+                                                     const std::uint64_t memoryLimit)
+            : baseLayer(baseLayer),
+              mangle(mangle),
+              stubs(executionSession, mainLib, "<bodies>", mangle, lazyCallThroughManager, std::move(stubsManager)),
+              memoryMapper(memoryMapper),
+              memoryLimit(memoryLimit) {
+        stubs.getBodiesLib().addGenerator(std::make_unique<BodyGenerator>(*this));
+    }
+
+    Error FunctionEvictionManager::addModule(ThreadSafeModule threadSafeModule) {
+        return threadSafeModule.withModuleDo([this](const Module &module) -> Error {
+            for (const auto &function: module) {
+                if (function.isDeclaration()) {
+                    continue;
+                }
+                if (auto error = addFunction(module, function)) {
+                    return error;
+                }
+            }
+            return Error::success();
+        });
+    }
+
+    Error FunctionEvictionManager::addFunction(const Module &module, const llvm::Function &function) {
+        auto record = std::make_unique<Function>();
+        record->name = function.getName().str();
+        auto body = cloneFunction(module, function);
+        if (!body) {
+            return body.takeError();
+        }
+        auto *const bodyFunction = (*body)->getFunction(record->name);
+        bodyFunction->setName(record->name + bodySuffix);
+        countCalls(*bodyFunction, record->name + callsSuffix);
+        raw_string_ostream os(record->bitcode);
+        WriteBitcodeToFile(**body, os);
+        os.flush();
+
+        SymbolMap symbols;
+        symbols[mangle(record->name + callsSuffix)] = {ExecutorAddr::fromPtr(&record->calls), JITSymbolFlags::Exported};
+        if (auto error = stubs.define(record->name, record->name + bodySuffix, std::move(symbols))) {
+            return error;
+        }
+
+        std::lock_guard lock(functionsMutex);
+        functions[mangle(record->name + bodySuffix)] = std::move(record);
+        return Error::success();
+    }
+
+    Error FunctionEvictionManager::materializeBody(const SymbolStringPtr &bodyName) {
+        const Function *function;
+        ResourceTrackerSP tracker;
+        {
+            std::lock_guard lock(functionsMutex);
+            const auto found = functions.find(bodyName);
+            if (found == functions.end() || found->second->tracker != nullptr) {
+                return Error::success();
+            }
+            function = found->second.get();
+            tracker = found->second->tracker = stubs.getBodiesLib().createResourceTracker();
+        }
+        auto context = std::make_unique<LLVMContext>();
+        auto module = parseBitcodeFile(MemoryBufferRef(function->bitcode, function->name), *context);
+        if (!module) {
+            return module.takeError();
+        }
+        ++compilations_;
+        return baseLayer.add(std::move(tracker), ThreadSafeModule(std::move(*module), std::move(context)));
+    }
+
+    Error FunctionEvictionManager::evictColdFunctions() {
+        std::vector<Function *> compiled;
+        {
+            std::lock_guard lock(functionsMutex);
+            ++sweeps;
+            for (const auto &[bodyName, function]: functions) {
+                const auto calls = function->calls.load(std::memory_order_relaxed);
+                if (calls != function->callsAtLastSweep) {
+                    function->callsAtLastSweep = calls;
+                    function->lastUse = sweeps;
+                }
+                if (function->tracker != nullptr) {
+                    compiled.push_back(function.get());
+                }
+            }
+        }
+        auto usedBytes = memoryMapper.getStats().usedBytes;
+        if (usedBytes <= memoryLimit) {
+            return Error::success();
+        }
+        // Least recently used first, the least called of those first.
+        std::sort(compiled.begin(), compiled.end(), [](const Function *lhs, const Function *rhs) {
+            return std::tie(lhs->lastUse, lhs->callsAtLastSweep) < std::tie(rhs->lastUse, rhs->callsAtLastSweep);
+        });
+        for (auto *const function: compiled) {
+            if (usedBytes <= memoryLimit) {
+                break;
+            }
+            if (auto error = stubs.reset(function->name, function->name + bodySuffix)) {
+                return error;
+            }
+            ResourceTrackerSP tracker;
+            {
+                std::lock_guard lock(functionsMutex);
+                tracker = std::move(function->tracker);
+            }
+            if (auto error = tracker->remove()) {
+                return error;
+            }
+            ++evictions_;
+            usedBytes = memoryMapper.getStats().usedBytes;
+        }
+        return Error::success();
+    }
+
+    std::uint64_t FunctionEvictionManager::compilations() const {
+        return compilations_;
+    }
+
+    std::uint64_t FunctionEvictionManager::evictions() const {
+        return evictions_;
+    }
+
+} // namespace llvm::orc
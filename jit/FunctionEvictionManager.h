@@ -0,0 +1,83 @@
+#ifndef FUNCTIONEVICTIONMANAGER_H
+#define FUNCTIONEVICTIONMANAGER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ExecutionEngine/Orc/Core.h"
+#include "llvm/ExecutionEngine/Orc/IndirectionUtils.h"
+#include "llvm/ExecutionEngine/Orc/LazyReexports.h"
+#include "llvm/ExecutionEngine/Orc/Layer.h"
+#include "llvm/ExecutionEngine/Orc/Mangling.h"
+
+#include "FunctionStubs.h"
+#include "SlabMemoryMapper.h"
+
+namespace llvm::orc {
+
+    // Keeps the machine code of the functions under a memory limit. Every function is called through a stub, its
+    // body is compiled on the first call under a resource tracker of its own, and only the bitcode stays resident.
+    // Bodies count their calls; when the linked code exceeds the limit, the functions which weren't called for the
+    // longest time are removed and their stubs point back to a lazy call-through, which compiles them again.
+    class FunctionEvictionManager final {
+    public:
+        FunctionEvictionManager(ExecutionSession &executionSession,
+                                IRLayer &baseLayer,
+                                JITDylib &mainLib,
+                                MangleAndInterner &mangle,
+                                LazyCallThroughManager &lazyCallThroughManager,
+                                std::unique_ptr<IndirectStubsManager> stubsManager,
+                                const SlabMemoryMapper &memoryMapper,
+                                std::uint64_t memoryLimit);
+
+        // Defines every function of the module in the main JITDylib; nothing is compiled until a function is called.
+        Error addModule(ThreadSafeModule threadSafeModule);
+
+        // Evicts the coldest functions until the linked code fits the limit. No JIT code may run meanwhile, a
+        // function can't be removed while it is on the stack.
+        Error evictColdFunctions();
+
+        [[nodiscard]] std::uint64_t compilations() const;
+
+        [[nodiscard]] std::uint64_t evictions() const;
+
+    private:
+        class BodyGenerator;
+
+        struct Function {
+            std::string name;
+            std::string bitcode;
+            // Incremented by the body itself.
+            std::atomic<std::uint64_t> calls{0};
+            std::uint64_t callsAtLastSweep = 0;
+            // Sweep in which the function was last seen called.
+            std::uint64_t lastUse = 0;
+            // Tracker of the linked body, null while the function isn't compiled.
+            ResourceTrackerSP tracker;
+        };
+
+        Error addFunction(const Module &module, const llvm::Function &function);
+
+        // Adds the body of the function to the bodies JITDylib; called by the generator on the first call.
+        Error materializeBody(const SymbolStringPtr &bodyName);
+
+        IRLayer &baseLayer;
+        MangleAndInterner &mangle;
+        FunctionStubs stubs;
+        const SlabMemoryMapper &memoryMapper;
+        const std::uint64_t memoryLimit;
+        std::mutex functionsMutex;
+        // Keyed by the mangled name of the body.
+        DenseMap<SymbolStringPtr, std::unique_ptr<Function>> functions;
+        std::uint64_t sweeps = 0;
+        std::atomic<std::uint64_t> compilations_{0};
+        std::atomic<std::uint64_t> evictions_{0};
+    };
+
+} // namespace llvm::orc
+
+#endif //FUNCTIONEVICTIONMANAGER_H
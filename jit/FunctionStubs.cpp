@@ -0,0 +1,74 @@
+#include "FunctionStubs.h"
+
+#include "llvm/Transforms/Utils/Cloning.h"
+
+namespace llvm::orc {
+
+    FunctionStubs::FunctionStubs(ExecutionSession &executionSession,
+                                 JITDylib &mainLib,
+                                 const std::string &bodiesLibName,
+                                 MangleAndInterner &mangle,
+                                 LazyCallThroughManager &lazyCallThroughManager,
+                                 std::unique_ptr<IndirectStubsManager> stubsManager)
+            : mainLib(mainLib),
+              bodiesLib(executionSession.createBareJITDylib(bodiesLibName)),
+              mangle(mangle),
+              lazyCallThroughManager(lazyCallThroughManager),
+              stubsManager(std::move(stubsManager)) {
+        bodiesLib.addToLinkOrder(mainLib);
+    }
+
+    Error FunctionStubs::define(const std::string &name, const std::string &bodyName, SymbolMap symbols) {
+        const auto stubName = mangle(name);
+        auto callThrough = createCallThrough(name, bodyName);
+        if (!callThrough) {
+            return callThrough.takeError();
+        }
+        if (auto error = stubsManager->createStub(*stubName, *callThrough, JITSymbolFlags::Exported
+                                                                          | JITSymbolFlags::Callable)) {
+            return error;
+        }
+        symbols[stubName] = {stubsManager->findStub(*stubName, true).getAddress(),
+                             JITSymbolFlags::Exported | JITSymbolFlags::Callable};
+        return mainLib.define(absoluteSymbols(std::move(symbols)));
+    }
+
+    Error FunctionStubs::reset(const std::string &name, const std::string &bodyName) {
+        auto callThrough = createCallThrough(name, bodyName);
+        if (!callThrough) {
+            return callThrough.takeError();
+        }
+        return update(name, *callThrough);
+    }
+
+    Error FunctionStubs::update(const std::string &name, const ExecutorAddr body) {
+        return stubsManager->updatePointer(*mangle(name), body);
+    }
+
+    Expected<ExecutorAddr> FunctionStubs::createCallThrough(const std::string &name, const std::string &bodyName) {
+        return lazyCallThroughManager.getCallThroughTrampoline(
+                bodiesLib, mangle(bodyName),
+                [this, stubName = (*mangle(name)).str()](const ExecutorAddr body) {
+                    return stubsManager->updatePointer(stubName, body);
+                });
+    }
+
+    Expected<std::unique_ptr<Module>> cloneFunction(const Module &module, const llvm::Function &function) {
+        for (const auto &variable: module.globals()) {
+            if (!variable.isDeclaration()) {
+                return createStringError(inconvertibleErrorCode(),
+                                         "can't split " + module.getModuleIdentifier() + " into functions, it defines "
+                                         + variable.getName().str());
+            }
+        }
+        if (!module.alias_empty()) {
+            return createStringError(inconvertibleErrorCode(),
+                                     "can't split " + module.getModuleIdentifier() + " into functions, it has aliases");
+        }
+        ValueToValueMapTy valueMap;
+        return CloneModule(module, valueMap, [&function](const GlobalValue *value) {
+            return value == &function;
+        });
+    }
+
+} // namespace llvm::orc
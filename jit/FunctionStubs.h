@@ -0,0 +1,57 @@
+#ifndef FUNCTIONSTUBS_H
+#define FUNCTIONSTUBS_H
+
+#include <memory>
+#include <string>
+
+#include "llvm/ExecutionEngine/Orc/Core.h"
+#include "llvm/ExecutionEngine/Orc/IndirectionUtils.h"
+#include "llvm/ExecutionEngine/Orc/LazyReexports.h"
+#include "llvm/ExecutionEngine/Orc/Mangling.h"
+#include "llvm/IR/Module.h"
+
+namespace llvm::orc {
+
+    // Stubs in the main JITDylib through which every call of a function goes, while its bodies live in a JITDylib of
+    // their own, so that a body can be replaced or removed without touching its callers. A stub first points at a
+    // lazy call-through, which materializes a body on the first call and points the stub at it.
+    class FunctionStubs final {
+    public:
+        FunctionStubs(ExecutionSession &executionSession,
+                      JITDylib &mainLib,
+                      const std::string &bodiesLibName,
+                      MangleAndInterner &mangle,
+                      LazyCallThroughManager &lazyCallThroughManager,
+                      std::unique_ptr<IndirectStubsManager> stubsManager);
+
+        // Bodies call other functions through their stubs and find the host symbols in the main JITDylib.
+        [[nodiscard]] JITDylib &getBodiesLib() const { return bodiesLib; }
+
+        // Defines the stub of the function in the main JITDylib, pointing at a call-through to bodyName, together with
+        // the symbols, e.g. counters written by the body.
+        Error define(const std::string &name, const std::string &bodyName, SymbolMap symbols);
+
+        // Points the stub back at a fresh call-through to bodyName; a call-through is used up by the body it
+        // materialized.
+        Error reset(const std::string &name, const std::string &bodyName);
+
+        Error update(const std::string &name, ExecutorAddr body);
+
+    private:
+        Expected<ExecutorAddr> createCallThrough(const std::string &name, const std::string &bodyName);
+
+        JITDylib &mainLib;
+        JITDylib &bodiesLib;
+        MangleAndInterner &mangle;
+        LazyCallThroughManager &lazyCallThroughManager;
+        std::unique_ptr<IndirectStubsManager> stubsManager;
+    };
+
+    // A copy of the module in which the function is the only definition; the other functions become declarations
+    // and are called through their stubs. Fails for a module which defines global variables or aliases, since they
+    // have no stubs: every body would link against a definition which none of the copies contains.
+    Expected<std::unique_ptr<Module>> cloneFunction(const Module &module, const llvm::Function &function);
+
+} // namespace llvm::orc
+
+#endif //FUNCTIONSTUBS_H
@@ -0,0 +1,81 @@
+#include "PersistentObjectCache.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA256.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace llvm::orc {
+
+    PersistentObjectCache::PersistentObjectCache(std::string cacheDir, std::string targetKey)
+            : cacheDir(std::move(cacheDir)),
+              targetKey(std::move(targetKey)) {
+    }
+
+    void PersistentObjectCache::notifyObjectCompiled(const Module *const module, const MemoryBufferRef object) {
+        std::string path;
+        {
+            std::lock_guard lock(pendingPathsMutex);
+            const auto pendingPath = pendingPaths.find(module);
+            if (pendingPath == pendingPaths.end()) {
+                return;
+            }
+            path = std::move(pendingPath->second);
+            pendingPaths.erase(pendingPath);
+        }
+        int fd = -1;
+        SmallString<128> tempPath;
+        if (sys::fs::createUniqueFile(path + ".%%%%%%.tmp", fd, tempPath)) {
+            return;
+        }
+        {
+            raw_fd_ostream os(fd, /*shouldClose*/ true);
+            os << object.getBuffer();
+            os.close();
+            if (os.has_error()) {
+                os.clear_error();
+                sys::fs::remove(tempPath);
+                return;
+            }
+        }
+        if (sys::fs::rename(tempPath, path)) {
+            sys::fs::remove(tempPath);
+        }
+    }
+
+    std::unique_ptr<MemoryBuffer> PersistentObjectCache::getObject(const Module *const module) {
+        auto path = objectPath(*module);
+        auto object = MemoryBuffer::getFile(path, /*IsText*/ false, /*RequiresNullTerminator*/ false);
+        if (!object) {
+            ++misses_;
+            std::lock_guard lock(pendingPathsMutex);
+            pendingPaths[module] = std::move(path);
+            return nullptr;
+        }
+        ++hits_;
+        return std::move(*object);
+    }
+
+    std::uint64_t PersistentObjectCache::hits() const {
+        return hits_.load();
+    }
+
+    std::uint64_t PersistentObjectCache::misses() const {
+        return misses_.load();
+    }
+
+    std::string PersistentObjectCache::objectPath(const Module &module) const {
+        std::string key;
+        raw_string_ostream os(key);
+        module.print(os, nullptr);
+        os << targetKey;
+        os.flush();
+
+        SmallString<128> path(cacheDir);
+        sys::path::append(path, toHex(SHA256::hash(arrayRefFromStringRef(key)), /*LowerCase*/ true) + ".o");
+        return std::string(path);
+    }
+
+} // namespace llvm::orc
@@ -0,0 +1,49 @@
+#ifndef PERSISTENTOBJECTCACHE_H
+#define PERSISTENTOBJECTCACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+namespace llvm::orc {
+
+    // Keeps the object files of compiled modules in a directory, so that a restarted process loads them instead of
+    // running the backend. An object is keyed by the SHA-256 of the module IR and of the target key, which must
+    // describe everything else that affects codegen (triple, CPU, features, opt level).
+    // Files are written to a unique temporary name and renamed into place, so concurrent processes sharing the
+    // directory never read a partially written object.
+    class PersistentObjectCache final : public ObjectCache {
+    public:
+        PersistentObjectCache(std::string cacheDir, std::string targetKey);
+
+        void notifyObjectCompiled(const Module *module, MemoryBufferRef object) override;
+
+        std::unique_ptr<MemoryBuffer> getObject(const Module *module) override;
+
+        [[nodiscard]] std::uint64_t hits() const;
+
+        [[nodiscard]] std::uint64_t misses() const;
+
+    private:
+        [[nodiscard]] std::string objectPath(const Module &module) const;
+
+        const std::string cacheDir;
+        const std::string targetKey;
+        // Paths of the modules being compiled. The backend rewrites the IR while compiling, so the path is computed
+        // from the IR in getObject() and reused when the object arrives.
+        std::mutex pendingPathsMutex;
+        std::unordered_map<const Module *, std::string> pendingPaths;
+        std::atomic<std::uint64_t> hits_{0};
+        std::atomic<std::uint64_t> misses_{0};
+    };
+
+} // namespace llvm::orc
+
+#endif //PERSISTENTOBJECTCACHE_H
@@ -0,0 +1,131 @@
+#include "ProfileGuidedOptimizer.h"
+
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "ir/ProfileInstrumentation.h"
+
+namespace llvm::orc {
+
+    namespace {
+        constexpr auto instrumentedSuffix = ".instrumented";
+        constexpr auto optimizedSuffix = ".optimized";
+        constexpr auto countersSuffix = ".counters";
+    } // namespace
+
+    ProfileGuidedOptimizer::ProfileGuidedOptimizer(ExecutionSession &executionSession,
+                                                   IRLayer &baseLayer,
+                                                   JITDylib &mainLib,
+                                                   MangleAndInterner &mangle,
+                                                   LazyCallThroughManager &lazyCallThroughManager,
+                                                   std::unique_ptr<IndirectStubsManager> stubsManager,
+                                                   const std::uint64_t warmupCalls)
+            : baseLayer(baseLayer),
+              mangle(mangle),
+              stubs(executionSession, mainLib, "<profiled bodies>", mangle, lazyCallThroughManager,
+                    std::move(stubsManager)),
+              warmupCalls(warmupCalls) {
+    }
+
+    Error ProfileGuidedOptimizer::addModule(ThreadSafeModule threadSafeModule) {
+        auto context = threadSafeModule.getContext();
+        return threadSafeModule.withModuleDo([this, &context](const Module &module) -> Error {
+            for (const auto &function: module) {
+                if (function.isDeclaration()) {
+                    continue;
+                }
+                if (auto error = addFunction(module, function, context)) {
+                    return error;
+                }
+            }
+            return Error::success();
+        });
+    }
+
+    Error ProfileGuidedOptimizer::addFunction(const Module &module,
+                                              const llvm::Function &function,
+                                              const ThreadSafeContext &context) {
+        auto record = std::make_unique<Function>();
+        record->name = function.getName().str();
+        auto body = cloneFunction(module, function);
+        if (!body) {
+            return body.takeError();
+        }
+        raw_string_ostream os(record->bitcode);
+        WriteBitcodeToFile(**body, os);
+        os.flush();
+
+        // The instrumented copy shares the context of the module, whose lock the caller holds.
+        auto *const instrumentedFunction = (*body)->getFunction(record->name);
+        instrumentedFunction->setName(record->name + instrumentedSuffix);
+        record->counters.resize(countersOf(*instrumentedFunction));
+        instrumentFunction(*instrumentedFunction, record->name + countersSuffix);
+        record->tracker = stubs.getBodiesLib().createResourceTracker();
+        if (auto error = baseLayer.add(record->tracker, ThreadSafeModule(std::move(*body), context))) {
+            return error;
+        }
+
+        // The body finds its counters in the main JITDylib.
+        SymbolMap symbols;
+        symbols[mangle(record->name + countersSuffix)] = {ExecutorAddr::fromPtr(record->counters.data()),
+                                                          JITSymbolFlags::Exported};
+        if (auto error = stubs.define(record->name, record->name + instrumentedSuffix, std::move(symbols))) {
+            return error;
+        }
+
+        std::lock_guard lock(functionsMutex);
+        functions.push_back(std::move(record));
+        return Error::success();
+    }
+
+    Error ProfileGuidedOptimizer::reoptimize(Function &function) {
+        auto context = std::make_unique<LLVMContext>();
+        auto module = parseBitcodeFile(MemoryBufferRef(function.bitcode, function.name), *context);
+        if (!module) {
+            return module.takeError();
+        }
+        auto *const optimizedFunction = (*module)->getFunction(function.name);
+        applyProfile(*optimizedFunction, function.counters);
+        optimizedFunction->setName(function.name + optimizedSuffix);
+        auto &bodiesLib = stubs.getBodiesLib();
+        if (auto error = baseLayer.add(bodiesLib.getDefaultResourceTracker(),
+                                       ThreadSafeModule(std::move(*module), std::move(context)))) {
+            return error;
+        }
+        auto body = bodiesLib.getExecutionSession().lookup({&bodiesLib}, mangle(function.name + optimizedSuffix));
+        if (!body) {
+            return body.takeError();
+        }
+        if (auto error = stubs.update(function.name, body->getAddress())) {
+            return error;
+        }
+        const auto tracker = std::move(function.tracker);
+        return tracker->remove();
+    }
+
+    Error ProfileGuidedOptimizer::reoptimizeHotFunctions() {
+        std::vector<Function *> hotFunctions;
+        {
+            std::lock_guard lock(functionsMutex);
+            for (const auto &function: functions) {
+                if (function->tracker != nullptr && function->counters.front() >= warmupCalls) {
+                    hotFunctions.push_back(function.get());
+                }
+            }
+        }
+        for (auto *const function: hotFunctions) {
+            if (auto error = reoptimize(*function)) {
+                return error;
+            }
+            ++reoptimizations_;
+        }
+        return Error::success();
+    }
+
+    std::uint64_t ProfileGuidedOptimizer::reoptimizations() const {
+        return reoptimizations_;
+    }
+
+} // namespace llvm::orc
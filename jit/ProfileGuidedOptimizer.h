@@ -0,0 +1,70 @@
+#ifndef PROFILEGUIDEDOPTIMIZER_H
+#define PROFILEGUIDEDOPTIMIZER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ExecutionEngine/Orc/Core.h"
+#include "llvm/ExecutionEngine/Orc/IndirectionUtils.h"
+#include "llvm/ExecutionEngine/Orc/LazyReexports.h"
+#include "llvm/ExecutionEngine/Orc/Layer.h"
+#include "llvm/ExecutionEngine/Orc/Mangling.h"
+
+#include "FunctionStubs.h"
+
+namespace llvm::orc {
+
+    // Two-tier compilation driven by a profile. Every function is called through a stub which first points at a copy
+    // of the function instrumented with block and branch counters, compiled on its first call. Once a function was
+    // called warmupCalls times, reoptimizeHotFunctions() compiles the original IR again with the collected branch
+    // weights and entry count attached, and points the stub at the result.
+    class ProfileGuidedOptimizer final {
+    public:
+        ProfileGuidedOptimizer(ExecutionSession &executionSession,
+                               IRLayer &baseLayer,
+                               JITDylib &mainLib,
+                               MangleAndInterner &mangle,
+                               LazyCallThroughManager &lazyCallThroughManager,
+                               std::unique_ptr<IndirectStubsManager> stubsManager,
+                               std::uint64_t warmupCalls);
+
+        // Defines every function of the module in the main JITDylib; nothing is compiled until a function is called.
+        Error addModule(ThreadSafeModule threadSafeModule);
+
+        // Recompiles the functions which finished their warm-up and removes their instrumented code. No JIT code may
+        // run meanwhile, an instrumented body can't be removed while it is on the stack.
+        Error reoptimizeHotFunctions();
+
+        [[nodiscard]] std::uint64_t reoptimizations() const;
+
+    private:
+        struct Function {
+            std::string name;
+            std::string bitcode;
+            // Written by the instrumented body, see instrumentFunction().
+            std::vector<std::uint64_t> counters;
+            // Tracker of the instrumented body, null once the function is reoptimized.
+            ResourceTrackerSP tracker;
+        };
+
+        Error addFunction(const Module &module, const llvm::Function &function, const ThreadSafeContext &context);
+
+        Error reoptimize(Function &function);
+
+        IRLayer &baseLayer;
+        MangleAndInterner &mangle;
+        FunctionStubs stubs;
+        const std::uint64_t warmupCalls;
+        std::mutex functionsMutex;
+        std::vector<std::unique_ptr<Function> > functions;
+        std::atomic<std::uint64_t> reoptimizations_{0};
+    };
+
+} // namespace llvm::orc
+
+#endif //PROFILEGUIDEDOPTIMIZER_H
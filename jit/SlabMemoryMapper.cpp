@@ -0,0 +1,101 @@
+#include "SlabMemoryMapper.h"
+
+#include "llvm/Support/Process.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace llvm::orc {
+
+    SlabMemoryMapper::SlabMemoryMapper(const size_t pageSize, const size_t slabSize, const bool hugePages)
+            : InProcessMemoryMapper(pageSize),
+              slabSize(slabSize),
+              hugePages(hugePages) {
+    }
+
+    Expected<std::unique_ptr<SlabMemoryMapper>> SlabMemoryMapper::Create(const size_t slabSize, const bool hugePages) {
+        auto pageSize = sys::Process::getPageSize();
+        if (!pageSize) {
+            return pageSize.takeError();
+        }
+        return std::make_unique<SlabMemoryMapper>(*pageSize, slabSize, hugePages);
+    }
+
+    void SlabMemoryMapper::reserve(const size_t numBytes, OnReservedFunction onReserved) {
+        InProcessMemoryMapper::reserve(
+                numBytes, [this, onReserved = std::move(onReserved)](Expected<ExecutorAddrRange> range) mutable {
+                    if (range) {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+                        if (hugePages) {
+                            // Only a hint, the slab works the same when the kernel can't provide huge pages.
+                            madvise(range->Start.toPtr<void *>(), range->size(), MADV_HUGEPAGE);
+                        }
+#endif
+                        std::lock_guard lock(sizesMutex);
+                        reservationSizes[range->Start] = range->size();
+                        ++slabs;
+                    }
+                    onReserved(std::move(range));
+                });
+    }
+
+    void SlabMemoryMapper::initialize(AllocInfo &allocInfo, OnInitializedFunction onInitialized) {
+        std::uint64_t pageBytes = 0;
+        std::uint64_t contentBytes = 0;
+        for (const auto &segment: allocInfo.Segments) {
+            pageBytes += alignTo(segment.ContentSize + segment.ZeroFillSize, getPageSize());
+            contentBytes += segment.ContentSize + segment.ZeroFillSize;
+        }
+        InProcessMemoryMapper::initialize(
+                allocInfo, [this, pageBytes, contentBytes, onInitialized = std::move(onInitialized)](
+                Expected<ExecutorAddr> addr) mutable {
+                    if (addr) {
+                        std::lock_guard lock(sizesMutex);
+                        allocationSizes[*addr] = {pageBytes, contentBytes};
+                    }
+                    onInitialized(std::move(addr));
+                });
+    }
+
+    void SlabMemoryMapper::deinitialize(const ArrayRef<ExecutorAddr> allocations,
+                                        OnDeinitializedFunction onDeinitialized) {
+        {
+            std::lock_guard lock(sizesMutex);
+            for (const auto addr: allocations) {
+                allocationSizes.erase(addr);
+            }
+        }
+        InProcessMemoryMapper::deinitialize(allocations, std::move(onDeinitialized));
+    }
+
+    void SlabMemoryMapper::release(const ArrayRef<ExecutorAddr> reservations, OnReleasedFunction onReleased) {
+        {
+            std::lock_guard lock(sizesMutex);
+            for (const auto addr: reservations) {
+                reservationSizes.erase(addr);
+            }
+        }
+        InProcessMemoryMapper::release(reservations, std::move(onReleased));
+    }
+
+    size_t SlabMemoryMapper::getSlabSize() const {
+        return slabSize;
+    }
+
+    JITMemoryStats SlabMemoryMapper::getStats() const {
+        JITMemoryStats stats;
+        std::lock_guard lock(sizesMutex);
+        for (const auto &[addr, size]: reservationSizes) {
+            stats.reservedBytes += size;
+        }
+        for (const auto &[addr, sizes]: allocationSizes) {
+            stats.usedBytes += sizes.first;
+            stats.contentBytes += sizes.second;
+        }
+        stats.allocations = allocationSizes.size();
+        stats.slabs = slabs;
+        return stats;
+    }
+
+} // namespace llvm::orc
@@ -0,0 +1,64 @@
+#ifndef SLABMEMORYMAPPER_H
+#define SLABMEMORYMAPPER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ExecutionEngine/Orc/MemoryMapper.h"
+
+namespace llvm::orc {
+
+    struct JITMemoryStats {
+        // Address space reserved for slabs.
+        std::uint64_t reservedBytes = 0;
+        // Pages of the objects which are linked and not removed yet; every segment of an object starts on a page.
+        std::uint64_t usedBytes = 0;
+        // Code and data in those pages.
+        std::uint64_t contentBytes = 0;
+        // Linked objects which are not removed yet.
+        std::uint64_t allocations = 0;
+        // mmap calls made for slabs, as opposed to one per object with SectionMemoryManager.
+        std::uint64_t slabs = 0;
+    };
+
+    // Backs MapperJITLinkMemoryManager with large in-process slabs. The manager packs the segments of many objects
+    // into one slab instead of mapping pages per object, and returns the memory of removed objects to the slab.
+    // With huge pages the slabs are marked for transparent huge pages, so hot code of many small modules shares a
+    // few iTLB entries; the kernel backs only the 2 MiB aligned parts of a slab and ignores the hint without THP.
+    class SlabMemoryMapper final : public InProcessMemoryMapper {
+    public:
+        SlabMemoryMapper(size_t pageSize, size_t slabSize, bool hugePages);
+
+        static Expected<std::unique_ptr<SlabMemoryMapper>> Create(size_t slabSize, bool hugePages);
+
+        void reserve(size_t numBytes, OnReservedFunction onReserved) override;
+
+        void initialize(AllocInfo &allocInfo, OnInitializedFunction onInitialized) override;
+
+        void deinitialize(ArrayRef<ExecutorAddr> allocations, OnDeinitializedFunction onDeinitialized) override;
+
+        void release(ArrayRef<ExecutorAddr> reservations, OnReleasedFunction onReleased) override;
+
+        // Granularity of the reservations made by MapperJITLinkMemoryManager.
+        [[nodiscard]] size_t getSlabSize() const;
+
+        [[nodiscard]] JITMemoryStats getStats() const;
+
+    private:
+        const size_t slabSize;
+        const bool hugePages;
+        mutable std::mutex sizesMutex;
+        DenseMap<ExecutorAddr, std::uint64_t> reservationSizes;
+        // Page and content bytes of every allocation.
+        DenseMap<ExecutorAddr, std::pair<std::uint64_t, std::uint64_t>> allocationSizes;
+        std::atomic<std::uint64_t> slabs{0};
+    };
+
+} // namespace llvm::orc
+
+#endif //SLABMEMORYMAPPER_H
@@ -0,0 +1,19 @@
+#include "ThreadPoolTaskDispatcher.h"
+
+namespace llvm::orc {
+
+    ThreadPoolTaskDispatcher::ThreadPoolTaskDispatcher(const unsigned threads)
+            : threadPool(hardware_concurrency(threads)) {
+    }
+
+    void ThreadPoolTaskDispatcher::dispatch(std::unique_ptr<Task> task) {
+        // The pool stores copyable callbacks only.
+        std::shared_ptr<Task> sharedTask(std::move(task));
+        threadPool.async([sharedTask] { sharedTask->run(); });
+    }
+
+    void ThreadPoolTaskDispatcher::shutdown() {
+        threadPool.wait();
+    }
+
+} // namespace llvm::orc
@@ -0,0 +1,28 @@
+#ifndef THREADPOOLTASKDISPATCHER_H
+#define THREADPOOLTASKDISPATCHER_H
+
+#include <memory>
+
+#include "llvm/ExecutionEngine/Orc/TaskDispatch.h"
+#include "llvm/Support/ThreadPool.h"
+
+namespace llvm::orc {
+
+    // Runs materialization tasks on a fixed set of worker threads. Unlike DynamicThreadPoolTaskDispatcher, which
+    // starts a thread per task, the workers live as long as the session, so per-thread state such as the target
+    // machines of CachedIRCompiler is reused across modules.
+    class ThreadPoolTaskDispatcher final : public TaskDispatcher {
+    public:
+        explicit ThreadPoolTaskDispatcher(unsigned threads);
+
+        void dispatch(std::unique_ptr<Task> task) override;
+
+        void shutdown() override;
+
+    private:
+        ThreadPool threadPool;
+    };
+
+} // namespace llvm::orc
+
+#endif //THREADPOOLTASKDISPATCHER_H
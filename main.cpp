@@ -1,10 +1,16 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
 #include <iostream>
 #include <list>
 #include <memory>
 #include <sstream>
+#include <tuple>
 #include <utility>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "llvm/Analysis/AssumptionCache.h"
 #include "llvm/Analysis/BasicAliasAnalysis.h"
@@ -13,22 +19,23 @@
 #include "llvm/Analysis/OptimizationRemarkEmitter.h"
 #include "llvm/Analysis/ProfileSummaryInfo.h"
 #include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
-#include "llvm/IR/PassManager.h"
+#include "llvm/IR/ProfDataUtils.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Verifier.h"
-#include "llvm/Passes/PassBuilder.h"
-#include "llvm/Passes/StandardInstrumentations.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/TargetSelect.h"
-#include "llvm/Transforms/InstCombine/InstCombine.h"
-#include "llvm/Transforms/Scalar/GVN.h"
-#include "llvm/Transforms/Scalar/Reassociate.h"
-#include "llvm/Transforms/Scalar/SimplifyCFG.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
 
 #include "KaleidoscopeJIT.h"
 #include "Lexer.h"
@@ -43,9 +50,20 @@
 #include "ast/UnaryOpNode.h"
 #include "ast/VariableAccessNode.h"
 #include "ast/VariableDefinitionStatement.h"
+#include "aot/AotCompiler.h"
+#include "engine/Engine.h"
+#include "engine/HostFunctions.h"
+#include "ir/AstWalk.h"
 #include "ir/IRCodegen.h"
+#include "ir/GlobalVariables.h"
+#include "ir/IROptimizer.h"
+#include "ir/ParallelCodegen.h"
+#include "ir/ProfileInstrumentation.h"
+#include "ir/TypeInference.h"
+#include "jit/CachedIRCompiler.h"
 
 #include "Parser.h"
+#include "ScriptParser.h"
 
 namespace {
     std::unique_ptr<llvm::LLVMContext> llvmContext;
@@ -53,286 +71,130 @@ namespace {
     std::unique_ptr<llvm::IRBuilder<> > llvmIRBuilder;
     std::unique_ptr<llvm::orc::KaleidoscopeJIT> llvmJit;
     std::unordered_map<std::string, llvm::Value *> namedValues;
-    std::unique_ptr<llvm::FunctionPassManager> functionPassManager;
-    std::unique_ptr<llvm::FunctionAnalysisManager> functionAnalysisManager;
-    std::unique_ptr<llvm::ModuleAnalysisManager> moduleAnalysisManager;
-    std::unique_ptr<llvm::PassInstrumentationCallbacks> passInstsCallbacks;
-    std::unique_ptr<llvm::StandardInstrumentations> standardInsts;
+    std::unique_ptr<llvm::TargetMachine> targetMachine;
     const llvm::ExitOnError ExitOnError;
 
-    void initLlvmModules() {
-        llvmContext = std::make_unique<llvm::LLVMContext>();
-        llvmModule = std::make_unique<llvm::Module>("my cool jit", *llvmContext);
-        llvmModule->setDataLayout(llvmJit->getDataLayout());
-
-        llvmIRBuilder = std::make_unique<llvm::IRBuilder<> >(*llvmContext);
-
-        functionPassManager = std::make_unique<llvm::FunctionPassManager>();
-        functionAnalysisManager = std::make_unique<llvm::FunctionAnalysisManager>();
-        moduleAnalysisManager = std::make_unique<llvm::ModuleAnalysisManager>();
-        passInstsCallbacks = std::make_unique<llvm::PassInstrumentationCallbacks>();
-        standardInsts = std::make_unique<llvm::StandardInstrumentations>(*llvmContext, /*DebugLogging*/ true);
-        standardInsts->registerCallbacks(*passInstsCallbacks, moduleAnalysisManager.get());
-
-        // Add transform passes.
-        // Do simple "peephole" optimizations and bit-twiddling optzns.
-        functionPassManager->addPass(llvm::InstCombinePass());
-        // Reassociate expressions.
-        functionPassManager->addPass(llvm::ReassociatePass());
-        // Eliminate Common SubExpressions.
-        functionPassManager->addPass(llvm::GVNPass());
-        // Simplify the control flow graph (deleting unreachable blocks, etc).
-        functionPassManager->addPass(llvm::SimplifyCFGPass());
-
-        // Register analysis passes used in these transform passes.
-        functionAnalysisManager->registerPass([&] { return llvm::AAManager(); });
-        functionAnalysisManager->registerPass([&] { return llvm::AssumptionAnalysis(); });
-        functionAnalysisManager->registerPass([&] { return llvm::DominatorTreeAnalysis(); });
-        functionAnalysisManager->registerPass([&] { return llvm::LoopAnalysis(); });
-        functionAnalysisManager->registerPass([&] { return llvm::MemoryDependenceAnalysis(); });
-        functionAnalysisManager->registerPass([&] { return llvm::MemorySSAAnalysis(); });
-        functionAnalysisManager->registerPass([&] { return llvm::OptimizationRemarkEmitterAnalysis(); });
-        functionAnalysisManager->registerPass([&] {
-            return llvm::OuterAnalysisManagerProxy<llvm::ModuleAnalysisManager, llvm::Function>(*moduleAnalysisManager);
-        });
-        functionAnalysisManager->registerPass(
-            [&] { return llvm::PassInstrumentationAnalysis(passInstsCallbacks.get()); });
-        functionAnalysisManager->registerPass([&] { return llvm::TargetIRAnalysis(); });
-        functionAnalysisManager->registerPass([&] { return llvm::TargetLibraryAnalysis(); });
-        moduleAnalysisManager->registerPass([&] { return llvm::ProfileSummaryAnalysis(); });
-    }
-
-    std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > functionProtos;
-
-    std::unique_ptr<BaseNode> parseAstNodeItem(const std::unique_ptr<Lexer> &lexer);
-
-    std::unique_ptr<BaseNode> parseExpr(const std::unique_ptr<Lexer> &lexer, bool inExpression = false);
-
-    std::tuple<std::unique_ptr<ExpressionNode>, std::unique_ptr<BaseNode> > toExpr(std::unique_ptr<BaseNode> node) {
-        if (dynamic_cast<ExpressionNode *>(node.get()) != nullptr) {
-            return {std::unique_ptr<ExpressionNode>(dynamic_cast<ExpressionNode *>(node.release())), nullptr};
-        }
-        return {nullptr, std::move(node)};
-    }
-
-    std::tuple<std::unique_ptr<StatementNode>, std::unique_ptr<BaseNode> >
-    toStatement(std::unique_ptr<BaseNode> node) {
-        if (dynamic_cast<StatementNode *>(node.get()) != nullptr) {
-            return {std::unique_ptr<StatementNode>(dynamic_cast<StatementNode *>(node.release())), nullptr};
-        }
-        return {nullptr, std::move(node)};
-    }
-
-    std::unique_ptr<ExpressionNode> parseNumberExpr(const std::unique_ptr<Lexer> &lexer,
-                                                    const bool inExpression = false) {
-        auto number = std::make_unique<NumberNode>(strtod(lexer->getNumberValue().c_str(), nullptr));
-        lexer->readNextToken(inExpression);
-        return number;
-    }
-
-    std::unique_ptr<ExpressionNode> parseParentheses(const std::unique_ptr<Lexer> &lexer) {
-        if (lexer->getCurrentToken() != TokenType::LeftParenthesisToken) {
-            return nullptr;
-        }
-        lexer->readNextToken(); // eat TokenType::LeftParenthesis
-        auto expr = parseAstNodeItem(lexer);
-        if (lexer->getCurrentToken() != TokenType::RightParenthesisToken) {
-            return nullptr;
-        }
-        lexer->readNextToken(); // eat TokenType::RightParenthesis
-        return std::get<0>(toExpr(std::move(expr)));
-    }
-
-    std::unique_ptr<BaseNode> parseIdentifier(const std::unique_ptr<Lexer> &lexer, const bool inExpression = false) {
-        const std::string name = lexer->getIdentifier();
-        lexer->readNextToken(inExpression); // eat identifier
-        if (lexer->getCurrentToken() == TokenType::EqualsToken) {
-            lexer->readNextToken(); // eat =
-            auto expr = parseAstNodeItem(lexer);
-            return std::make_unique<VariableDefinitionStatement>(name, std::get<0>(toExpr(std::move(expr))));
-        }
-        if (lexer->getCurrentToken() != TokenType::LeftParenthesisToken) {
-            return std::make_unique<VariableAccessNode>(name);
-        }
-
-        std::vector<std::unique_ptr<ExpressionNode> > args;
-        lexer->readNextToken(); // eat TokenType::LeftParenthesis
-        while (true) {
-            if (auto arg = parseAstNodeItem(lexer)) {
-                args.push_back(std::get<0>(toExpr(std::move(arg))));
-                if (lexer->getCurrentToken() == TokenType::CommaToken) {
-                    lexer->readNextToken(); // eat ','
-                } else {
-                    break;
-                }
-            } else {
-                break;
-            }
-        }
-        if (lexer->getCurrentToken() != TokenType::RightParenthesisToken) {
-            return nullptr;
-        }
-        lexer->readNextToken(); // eat TokenType::RightParenthesis
-        return std::make_unique<CallFunctionNode>(name, std::move(args));
-    }
-
-    std::list<std::unique_ptr<BaseNode> > parseCurlyBrackets(const std::unique_ptr<Lexer> &lexer) {
-        std::list<std::unique_ptr<BaseNode> > expressions;
-        while (auto node = parseAstNodeItem(lexer)) {
-            expressions.push_back(std::move(node));
-            if (lexer->getCurrentToken() != TokenType::RightCurlyBracketToken) {
-                break;
-            }
-            lexer->readNextToken();
-        }
-        return expressions;
+    llvm::cl::opt<std::string> inputFile(llvm::cl::Positional,
+                                         llvm::cl::desc("<script, the built-in sample when omitted>"));
+
+    llvm::cl::opt<bool> aheadOfTime("aot",
+                                    llvm::cl::desc("Compile the defs of the script ahead of time instead of running it"));
+
+    llvm::cl::opt<std::string> outputFile(
+        "o",
+        llvm::cl::desc("Output of --aot: a shared library if it ends in .so, an object file otherwise"),
+        llvm::cl::value_desc("file"),
+        llvm::cl::init("a.o"));
+
+    llvm::cl::opt<bool> runBenchmarks("bench", llvm::cl::desc("Run the benchmarks instead of the sample script"));
+
+    llvm::cl::opt<bool> portableCpu("portable-cpu",
+                                    llvm::cl::desc("Generate code for the generic CPU of the target instead of the "
+                                                   "host CPU"));
+
+    llvm::cl::opt<llvm::CodeGenOptLevel> codeGenOptLevel(
+        "codegen-opt",
+        llvm::cl::desc("Backend optimization level"),
+        llvm::cl::values(clEnumValN(llvm::CodeGenOptLevel::None, "0", "No optimizations"),
+                         clEnumValN(llvm::CodeGenOptLevel::Less, "1", "Less optimizations"),
+                         clEnumValN(llvm::CodeGenOptLevel::Default, "2", "Default optimizations"),
+                         clEnumValN(llvm::CodeGenOptLevel::Aggressive, "3", "Aggressive optimizations")),
+        llvm::cl::init(llvm::CodeGenOptLevel::Default));
+
+    llvm::cl::opt<bool> lazyCompilation("lazy", llvm::cl::desc("Compile user functions on their first call"));
+
+    llvm::cl::opt<unsigned> compileThreads(
+        "compile-threads",
+        llvm::cl::desc("Threads which optimize and compile modules, 0 compiles on the main thread"),
+        llvm::cl::init(llvm::hardware_concurrency().compute_thread_count()));
+
+    llvm::cl::opt<bool> speculativeCompilation(
+        "speculate",
+        llvm::cl::desc("Generate the IR of every def as soon as it is parsed and compile it on the compile threads "
+                       "while the script goes on (takes precedence over --lazy)"));
+
+    llvm::cl::opt<std::string> objectCacheDir(
+        "object-cache",
+        llvm::cl::desc("Directory where compiled objects are cached across runs"),
+        llvm::cl::value_desc("dir"));
+
+    llvm::cl::opt<bool> jitLink("jitlink",
+                                llvm::cl::desc("Link JIT code with JITLink into shared slabs instead of RuntimeDyld"));
+
+    llvm::cl::opt<bool> hugePages("huge-pages",
+                                  llvm::cl::desc("Back the JITLink slabs with transparent huge pages"));
+
+    llvm::cl::opt<std::uint64_t> jitMemoryLimit(
+        "jit-memory-limit",
+        llvm::cl::desc("Evict the least recently called functions when the JIT code exceeds this size, they are "
+                       "compiled again on the next call (implies --jitlink, takes precedence over --lazy and "
+                       "--speculate)"),
+        llvm::cl::value_desc("KiB"));
+
+    llvm::cl::opt<std::uint64_t> profileWarmupCalls(
+        "pgo-warmup",
+        llvm::cl::desc("Instrument defs with block and branch counters and compile them again with the profile once "
+                       "they were called this many times (takes precedence over --lazy and --speculate)"),
+        llvm::cl::value_desc("calls"));
+
+    llvm::cl::list<std::string> builtinBitcodeFiles(
+        "builtins",
+        llvm::cl::desc("Bitcode whose functions scripts may call; they are linked into the calling modules and inlined"),
+        llvm::cl::value_desc("file.bc"));
+
+    llvm::cl::opt<unsigned> codegenThreads(
+        "codegen-threads",
+        llvm::cl::desc("Threads which generate the IR of a batch of defs"),
+        llvm::cl::init(llvm::hardware_concurrency().compute_thread_count()));
+
+    llvm::cl::opt<bool> wholeProgram(
+        "whole-program",
+        llvm::cl::desc("Compile the defs and top-level expressions of the script into one module, internalize and "
+                       "inline across defs, then run the expressions (ignores --lazy, --speculate, "
+                       "--jit-memory-limit and --pgo-warmup)"));
+
+    llvm::cl::list<std::string> fastMathFlags(
+        "fast-math",
+        llvm::cl::desc("Fast-math flags of the defs without a fast or strict attribute: reassoc, contract, nnan, ninf, "
+                       "nsz, arcp or fast for all of them (strict IEEE semantics when omitted)"),
+        llvm::cl::value_desc("flag,..."),
+        llvm::cl::CommaSeparated);
+
+    llvm::orc::JITOptions jitOptionsFromCommandLine() {
+        llvm::orc::JITOptions options;
+        options.targetHostCpu = !portableCpu;
+        options.codeGenOptLevel = codeGenOptLevel;
+        options.lazyCompilation = lazyCompilation;
+        options.compileThreads = compileThreads;
+        options.objectCacheDir = objectCacheDir;
+        options.jitLink = jitLink || hugePages;
+        options.hugePages = hugePages;
+        options.memoryLimit = jitMemoryLimit * 1024;
+        options.profileWarmupCalls = profileWarmupCalls;
+        return options;
     }
 
-    std::unique_ptr<StatementNode> parseIfExpression(const std::unique_ptr<Lexer> &lexer) {
-        lexer->readNextToken();
-        if (lexer->getCurrentToken() != TokenType::LeftParenthesisToken) {
-            return nullptr;
-        }
-        auto cond = parseParentheses(lexer);
-        if (lexer->getCurrentToken() != TokenType::LeftCurlyBracketToken) {
-            return nullptr;
-        }
-        lexer->readNextToken();
-        std::list<std::unique_ptr<BaseNode> > thenBranch = parseCurlyBrackets(lexer);
-        lexer->readNextToken();
-        std::optional<std::list<std::unique_ptr<BaseNode> > > elseBranch;
-        if (lexer->getCurrentToken() == TokenType::ElseToken) {
-            lexer->readNextToken();
-            if (lexer->getCurrentToken() != TokenType::LeftCurlyBracketToken) {
-                return nullptr;
+    FastMath fastMathFromCommandLine() {
+        FastMath fastMath;
+        for (const auto &flag: fastMathFlags) {
+            if (!fastMath.set(flag)) {
+                ExitOnError(llvm::createStringError(llvm::inconvertibleErrorCode(), "unknown fast-math flag " + flag));
             }
-            lexer->readNextToken();
-            elseBranch = parseCurlyBrackets(lexer);
-        }
-        return std::make_unique<IfStatement>(std::move(cond), std::move(thenBranch), std::move(elseBranch));
-    }
-
-    std::unique_ptr<StatementNode> parseForLoopExpression(const std::unique_ptr<Lexer> &lexer) {
-        lexer->readNextToken();
-        if (lexer->getCurrentToken() != TokenType::LeftParenthesisToken) {
-            return nullptr;
-        }
-        lexer->readNextToken();
-        auto loopInit = parseIdentifier(lexer);
-        if (loopInit == nullptr) {
-            return nullptr;
-        }
-        lexer->readNextToken(true);
-        auto loopFinish = parseAstNodeItem(lexer);
-        if (loopFinish == nullptr) {
-            return nullptr;
-        }
-        lexer->readNextToken(true);
-        auto loopNext = parseAstNodeItem(lexer);
-        if (loopNext == nullptr) {
-            return nullptr;
-        }
-        lexer->readNextToken();
-        if (lexer->getCurrentToken() != TokenType::LeftCurlyBracketToken) {
-            return nullptr;
-        }
-        lexer->readNextToken();
-        auto loopBody = parseCurlyBrackets(lexer);
-
-        auto forLoopExpr = std::make_unique<ForLoopNode>(std::get<0>(toStatement(std::move(loopInit))),
-                                                         std::get<0>(toExpr(std::move(loopNext))),
-                                                         std::get<0>(toExpr(std::move(loopFinish))),
-                                                         std::move(loopBody));
-        return forLoopExpr;
-    }
-
-    std::unique_ptr<ExpressionNode> parseUnaryExpression(const std::unique_ptr<Lexer> &lexer) {
-        const auto operatorType = lexer->getCurrentToken();
-        lexer->readNextToken(true);
-        auto expr = parseExpr(lexer, true);
-        return std::make_unique<UnaryOpNode>(operatorType,
-                                             std::get<0>(toExpr(std::move(expr))));
-    }
-
-    std::unique_ptr<StatementNode> parseStatement(const std::unique_ptr<Lexer> &lexer) {
-        if (lexer->getCurrentToken() == TokenType::IfToken) {
-            return parseIfExpression(lexer);
-        }
-        if (lexer->getCurrentToken() == TokenType::ForLoopToken) {
-            return parseForLoopExpression(lexer);
-        }
-        return nullptr;
-    }
-
-    std::unique_ptr<BaseNode> parseExpr(const std::unique_ptr<Lexer> &lexer, const bool inExpression) {
-        if (lexer->getCurrentToken() == TokenType::NumberToken) {
-            return parseNumberExpr(lexer, inExpression);
-        }
-        if (lexer->getCurrentToken() == TokenType::IdentifierToken) {
-            return parseIdentifier(lexer, inExpression);
-        }
-        if (lexer->getCurrentToken() == TokenType::IncrementOperatorToken
-            || lexer->getCurrentToken() == TokenType::DecrementOperatorToken) {
-            return parseUnaryExpression(lexer);
-        }
-        if (lexer->getCurrentToken() == TokenType::LeftParenthesisToken) {
-            return parseParentheses(lexer);
         }
-        return nullptr;
+        return fastMath;
     }
 
-    int getBinOpPrecedence(const TokenType binOp) {
-        int binOpPrec = -1;
-        if (binOp == TokenType::PlusToken || binOp == TokenType::MinusToken) {
-            binOpPrec = 1;
-        } else if (binOp == TokenType::DivideToken || binOp == TokenType::MultiplyToken) {
-            binOpPrec = 2;
-        } else if (binOp == TokenType::LeftAngleBracketToken || binOp == TokenType::RightAngleBracketToken) {
-            binOpPrec = 0;
-        }
-        return binOpPrec;
-    }
-
-    std::unique_ptr<ExpressionNode> parseBinOp(const std::unique_ptr<Lexer> &lexer,
-                                               const int expPrec,
-                                               std::unique_ptr<ExpressionNode> lhs) {
-        while (true) {
-            const auto binOp = lexer->getCurrentToken();
-            const int curBinOpPrec = getBinOpPrecedence(binOp);
-            if (curBinOpPrec < expPrec) {
-                return lhs;
-            }
-
-            lexer->readNextToken(true); // read rhs
-            auto rhs = parseExpr(lexer, true);
-            if (rhs == nullptr) {
-                return nullptr;
-            }
-
-            const auto nextBinOp = lexer->getCurrentToken();
-            if (const int nextBinOpPrec = getBinOpPrecedence(nextBinOp); curBinOpPrec < nextBinOpPrec) {
-                if (rhs = parseBinOp(lexer, curBinOpPrec, std::get<0>(toExpr(std::move(rhs)))); rhs == nullptr) {
-                    return nullptr;
-                }
-            }
+    void initLlvmModules() {
+        llvmContext = std::make_unique<llvm::LLVMContext>();
+        llvmModule = std::make_unique<llvm::Module>("my cool jit", *llvmContext);
+        llvmModule->setDataLayout(llvmJit->getDataLayout());
+        llvmModule->setTargetTriple(targetMachine->getTargetTriple().str());
 
-            lhs = std::make_unique<BinOpNode>(binOp, std::move(lhs), std::get<0>(toExpr(std::move(rhs))));
-        }
+        llvmIRBuilder = std::make_unique<llvm::IRBuilder<> >(*llvmContext);
     }
 
-    std::unique_ptr<BaseNode> parseAstNodeItem(const std::unique_ptr<Lexer> &lexer) {
-        if (auto node = parseExpr(lexer, true)) {
-            auto [expr, srcNode] = toExpr(std::move(node));
-            if (expr) {
-                return parseBinOp(lexer, 0, std::move(expr));
-            }
-            return std::move(srcNode);
-        }
-        if (auto statement = parseStatement(lexer)) {
-            return statement;
-        }
-        return nullptr;
-    }
+    std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > functionProtos;
+    std::unordered_set<std::string> globalVariables;
 
     void print(const llvm::Value *const llvmIR) {
         llvm::outs() << "IR: ";
@@ -361,116 +223,272 @@ namespace {
         } while (!values.empty());
     }
 
-    std::unique_ptr<ProtoFunctionStatement> parseProto(const std::unique_ptr<Lexer> &lexer) {
-        const std::string name = lexer->getIdentifier();
-        lexer->readNextToken(); // eat callee
-        if (lexer->getCurrentToken() != TokenType::LeftParenthesisToken) {
-            return nullptr;
+    double print(const double param) {
+        printf("print: %f\n", param);
+        return param;
+    }
+
+    void addDefinitions(std::vector<std::unique_ptr<FunctionNode> > &definitions) {
+        std::vector<const FunctionNode *> functions;
+        functions.reserve(definitions.size());
+        for (const auto &definition: definitions) {
+            functions.push_back(definition.get());
         }
-        lexer->readNextToken(); // eat TokenType::LeftParenthesis
-        std::vector<std::string> args;
-        while (lexer->hasNextToken()) {
-            if (lexer->getCurrentToken() != TokenType::IdentifierToken) {
-                break;
-            }
-            if (auto arg = parseIdentifier(lexer)) {
-                const auto *const var = dynamic_cast<const VariableAccessNode *>(arg.get());
-                args.push_back(var->name);
-                if (lexer->getCurrentToken() == TokenType::CommaToken) {
-                    lexer->readNextToken(); // eat next arg
+        for (auto &module: generateModules(functions,
+                                           functionProtos,
+                                           llvmJit->getDataLayout(),
+                                           targetMachine->getTargetTriple().str(),
+                                           codegenThreads,
+                                           fastMathFromCommandLine(),
+                                           globalVariables)) {
+            std::vector<std::string> names;
+            module.withModuleDo([&names](const llvm::Module &m) {
+                for (const auto &function: m) {
+                    if (!function.isDeclaration()) {
+                        print(&function);
+                        names.emplace_back(function.getName());
+                    }
                 }
-            } else {
-                break;
+            });
+            if (!speculativeCompilation || llvmJit->getEvictionManager() != nullptr
+                || llvmJit->getProfileGuidedOptimizer() != nullptr) {
+                ExitOnError(llvmJit->addLazyModule(std::move(module), nullptr));
+                continue;
+            }
+            ExitOnError(llvmJit->addModule(std::move(module), nullptr));
+            for (const auto &name: names) {
+                llvmJit->speculate(name);
             }
         }
-        if (lexer->getCurrentToken() != TokenType::RightParenthesisToken) {
-            return nullptr;
-        }
-        lexer->readNextToken(); // eat TokenType::RightParenthesis
-        return std::make_unique<ProtoFunctionStatement>(name, args);
+        definitions.clear();
     }
 
-    std::unique_ptr<FunctionNode> parseFunctionDefinition(const std::unique_ptr<Lexer> &lexer) {
-        lexer->readNextToken(); // eat def
-        auto proto = parseProto(lexer);
-        if (lexer->getCurrentToken() != TokenType::LeftCurlyBracketToken) {
-            return nullptr;
+    // Defines the globals which the top-level expression assigns, unless an earlier expression did.
+    void defineGlobals(const FunctionNode &expression) {
+        for (const auto &name: globalsAssignedBy(expression)) {
+            if (globalVariables.insert(name).second) {
+                ExitOnError(llvmJit->addModule(
+                    defineGlobal(name, llvmJit->getDataLayout(), targetMachine->getTargetTriple().str()), nullptr));
+            }
         }
-        lexer->readNextToken();
-        std::list<std::unique_ptr<BaseNode> > body = parseCurlyBrackets(lexer);
-        return std::make_unique<FunctionNode>(std::move(proto), std::move(body));
     }
 
-    std::unique_ptr<FunctionNode> parseTopLevelExpr(const std::unique_ptr<Lexer> &lexer,
-                                                    const char *const functionName) {
-        std::list<std::unique_ptr<BaseNode> > body;
-        while (auto expr = parseAstNodeItem(lexer)) {
-            body.push_back(std::move(expr));
-            lexer->readNextToken();
-        }
-        auto proto = std::make_unique<ProtoFunctionStatement>(
-            functionName, std::vector<std::string>());
-        return std::make_unique<FunctionNode>(std::move(proto), std::move(body));
+    // Whether the def reads a variable which is neither its own nor a global defined so far. It may be a global which a
+    // later top-level expression assigns, so the def can't be generated before that expression.
+    bool readsUnknownGlobals(const FunctionNode &definition) {
+        std::vector<std::string> read;
+        std::unordered_set<std::string> assigned;
+        collectVariables(definition.body, read, assigned);
+        assigned.insert(definition.proto->args.begin(), definition.proto->args.end());
+        return std::any_of(read.begin(), read.end(), [&assigned](const std::string &name) {
+            return !assigned.contains(name) && !globalVariables.contains(name);
+        });
     }
 
-    double print(const double param) {
-        printf("print: %f\n", param);
-        return param;
+    void printMemoryStats(const llvm::orc::JITMemoryStats &stats) {
+        std::cout << "memory: used=" << stats.usedBytes << " bytes (" << stats.contentBytes << " of content) in "
+                << stats.allocations << " objects, reserved=" << stats.reservedBytes << " bytes in " << stats.slabs << " slabs\n";
+    }
+
+    // The whole script is parsed up front. Top-level expressions become _start0, _start1, ... in the module of the
+    // defs; they are its only exports, so defs which all calls inline into disappear.
+    void wholeProgramHandler(const std::unique_ptr<Lexer> &lexer) {
+        std::vector<std::unique_ptr<FunctionNode> > nodes;
+        std::vector<std::string> expressions;
+        lexer->readNextToken();
+        while (lexer->hasNextToken()) {
+            if (lexer->getCurrentToken() == TokenType::FunctionDefinitionToken) {
+                if (auto definition = parseFunctionDefinition(lexer)) {
+                    nodes.push_back(std::move(definition));
+                }
+                lexer->readNextToken(); // eat '}'
+                continue;
+            }
+            const auto name = "_start" + std::to_string(expressions.size());
+            auto function = parseTopLevelExpr(lexer, name.c_str());
+            if (function->body.empty()) {
+                // Skip a token which can't start an expression.
+                lexer->readNextToken();
+                continue;
+            }
+            defineGlobals(*function);
+            nodes.push_back(std::move(function));
+            expressions.push_back(name);
+        }
+
+        std::vector<const FunctionNode *> functions;
+        for (const auto &node: nodes) {
+            functions.push_back(node.get());
+        }
+        auto module = generateModule(functions,
+                                     functionProtos,
+                                     llvmJit->getDataLayout(),
+                                     targetMachine->getTargetTriple().str(),
+                                     fastMathFromCommandLine(),
+                                     globalVariables);
+        for (const auto &name: expressions) {
+            functionProtos.erase(name);
+        }
+        module.withModuleDo([&expressions](llvm::Module &m) {
+            optimizeWholeProgram(m, *targetMachine, [&expressions](const llvm::GlobalValue &value) {
+                return std::find(expressions.begin(), expressions.end(), value.getName()) != expressions.end();
+            });
+            for (const auto &function: m) {
+                if (!function.isDeclaration()) {
+                    print(&function);
+                }
+            }
+        });
+        ExitOnError(llvmJit->addModule(std::move(module), nullptr));
+        for (const auto &name: expressions) {
+            auto *const start = ExitOnError(llvmJit->lookup(name)).getAddress().toPtr<double (*)()>();
+            std::cout << "result=" << start() << "\n";
+        }
     }
 
     void mainHandler(const std::unique_ptr<Lexer> &lexer) {
+        if (wholeProgram) {
+            wholeProgramHandler(lexer);
+            return;
+        }
+        // Defs are collected until a top-level expression may call them, then generated in parallel.
+        std::vector<std::unique_ptr<FunctionNode> > pendingDefinitions;
+        // Time the main thread spent generating the IR of defs and waiting for symbols, the compile time of the JIT
+        // before the script and the compile time which passed meanwhile, on any thread.
+        std::chrono::steady_clock::duration codegenTime{0};
+        std::chrono::steady_clock::duration waitTime{0};
+        const auto initialCompileTime = llvmJit->getCompileTime();
+        std::chrono::nanoseconds stalledCompileTime{0};
+        const auto blockMainThread = [&](std::chrono::steady_clock::duration &time, const auto &work) {
+            const auto start = std::chrono::steady_clock::now();
+            const auto compileTime = llvmJit->getCompileTime();
+            work();
+            time += std::chrono::steady_clock::now() - start;
+            stalledCompileTime += llvmJit->getCompileTime() - compileTime;
+        };
         lexer->readNextToken();
-        do {
+        while (lexer->hasNextToken()) {
             if (lexer->getCurrentToken() == TokenType::FunctionDefinitionToken) {
-                auto definition = parseFunctionDefinition(lexer);
-                if (definition != nullptr) {
+                if (auto definition = parseFunctionDefinition(lexer)) {
                     print(definition.get());
+                    pendingDefinitions.push_back(std::move(definition));
+                    // A def reading a global which isn't defined yet waits for the expression assigning it, and so do
+                    // the defs after it, which may call it.
+                    if (speculativeCompilation
+                        && std::none_of(pendingDefinitions.begin(), pendingDefinitions.end(),
+                                        [](const std::unique_ptr<FunctionNode> &pending) {
+                                            return readsUnknownGlobals(*pending);
+                                        })) {
+                        // Only the materialization is speculative: the IR is generated here, on the main thread,
+                        // and the compile threads optimize and compile it while the following top-level
+                        // expressions run. Without compile threads the compilation happens here as well.
+                        blockMainThread(codegenTime, [&pendingDefinitions] { addDefinitions(pendingDefinitions); });
+                    }
                 }
-                ExitOnError(llvmJit->addModule(
-                    llvm::orc::ThreadSafeModule(std::move(llvmModule), std::move(llvmContext)), nullptr));
-                initLlvmModules();
+                lexer->readNextToken(); // eat '}'
+                continue;
+            }
+            const auto function = parseTopLevelExpr(lexer, "_start");
+            if (function->body.empty()) {
+                // Skip a token which can't start an expression.
                 lexer->readNextToken();
-            } else {
-                if (const auto function = parseTopLevelExpr(lexer, "_start")) {
-                    const auto *const llvmIR = generateIR(function.get(),
-                                                          llvmContext,
-                                                          llvmIRBuilder,
-                                                          llvmModule,
-                                                          functionProtos,
-                                                          namedValues);
-                    if (llvmIR != nullptr) {
-                        print(llvmIR);
-                        const auto resourceTracker = llvmJit->getMainJITDylib().createResourceTracker();
-                        auto threadSafeModule = llvm::orc::ThreadSafeModule(std::move(llvmModule),
-                                                                            std::move(llvmContext));
-                        ExitOnError(llvmJit->addModule(std::move(threadSafeModule), resourceTracker));
-                        initLlvmModules();
-                        const auto startSymbol = ExitOnError(llvmJit->lookup("_start"));
-                        using FuncType = double (*)();
-                        auto *const startFunc = startSymbol.getAddress().toPtr<FuncType>();
-                        std::cout << "result=" << startFunc() << "\n";
-                        ExitOnError(resourceTracker->remove());
-                    }
+                continue;
+            }
+            // Defs parsed before the expression may read the globals it assigns.
+            defineGlobals(*function);
+            addDefinitions(pendingDefinitions);
+            declareGlobals(*llvmModule, globalVariables);
+            if (auto *const llvmIR = generateIR(function.get(),
+                                                llvmContext,
+                                                llvmIRBuilder,
+                                                llvmModule,
+                                                functionProtos,
+                                                namedValues)) {
+                print(llvmIR);
+                const auto resourceTracker = llvmJit->getMainJITDylib().createResourceTracker();
+                auto threadSafeModule = llvm::orc::ThreadSafeModule(std::move(llvmModule),
+                                                                    std::move(llvmContext));
+                ExitOnError(llvmJit->addModule(std::move(threadSafeModule), resourceTracker));
+                initLlvmModules();
+                llvm::orc::ExecutorSymbolDef startSymbol;
+                blockMainThread(waitTime, [&startSymbol] { startSymbol = ExitOnError(llvmJit->lookup("_start")); });
+                using FuncType = double (*)();
+                auto *const startFunc = startSymbol.getAddress().toPtr<FuncType>();
+                std::cout << "result=" << startFunc() << "\n";
+                ExitOnError(resourceTracker->remove());
+                ExitOnError(llvmJit->evictColdFunctions());
+                ExitOnError(llvmJit->reoptimizeHotFunctions());
+            }
+        }
+        addDefinitions(pendingDefinitions);
+
+        if (speculativeCompilation) {
+            // Codegen runs on the main thread; overlap is the compile time which passed while the main thread went on
+            // with the script rather than generating IR or waiting for a symbol.
+            using Milliseconds = std::chrono::duration<double, std::milli>;
+            const Milliseconds codegen = codegenTime;
+            const Milliseconds compileTime = llvmJit->getCompileTime() - initialCompileTime;
+            const Milliseconds waited = waitTime;
+            const Milliseconds overlap = compileTime - Milliseconds(stalledCompileTime);
+            std::cout << "stats: codegen=" << codegen.count() << " ms (main thread), compile=" << compileTime.count()
+                    << " ms, wait=" << waited.count() << " ms, overlap=" << overlap.count() << " ms\n";
+        }
+        if (const auto *const memoryMapper = llvmJit->getMemoryMapper()) {
+            printMemoryStats(memoryMapper->getStats());
+        }
+        if (const auto *const evictionManager = llvmJit->getEvictionManager()) {
+            std::cout << "eviction: compilations=" << evictionManager->compilations()
+                    << ", evictions=" << evictionManager->evictions() << "\n";
+        }
+        if (const auto *const profileGuidedOptimizer = llvmJit->getProfileGuidedOptimizer()) {
+            std::cout << "pgo: reoptimizations=" << profileGuidedOptimizer->reoptimizations() << "\n";
+        }
+    }
+
+    // Compiles the defs of the script into an object file or a shared library and a C header; top-level expressions
+    // have no place in a library and are skipped.
+    void compileScriptAheadOfTime(const std::unique_ptr<Lexer> &lexer) {
+        std::vector<std::unique_ptr<FunctionNode> > definitions;
+        lexer->readNextToken();
+        while (lexer->hasNextToken()) {
+            if (lexer->getCurrentToken() == TokenType::FunctionDefinitionToken) {
+                if (auto definition = parseFunctionDefinition(lexer)) {
+                    definitions.push_back(std::move(definition));
                 }
+                lexer->readNextToken(); // eat '}'
+                continue;
+            }
+            if (parseTopLevelExpr(lexer, "_start")->body.empty()) {
+                // Skip a token which can't start an expression.
                 lexer->readNextToken();
+                continue;
             }
-        } while (lexer->getCurrentToken() != TokenType::EosToken);
+            std::cerr << "skipping a top-level expression, only defs are compiled ahead of time\n";
+        }
+
+        std::vector<const FunctionNode *> functions;
+        for (const auto &definition: definitions) {
+            functions.push_back(definition.get());
+        }
+        // Built-in functions are declared for the script and provided by the program linking the output.
+        functionProtos["print"] = std::make_unique<ProtoFunctionStatement>("print", std::vector<std::string>{"param"});
+        AotOptions options;
+        options.outputPath = outputFile;
+        options.targetHostCpu = !portableCpu;
+        options.codeGenOptLevel = codeGenOptLevel;
+        options.fastMath = fastMathFromCommandLine();
+        ExitOnError(compileAheadOfTime(functions, functionProtos, options));
     }
 
     void defineEmbeddedFunctions() {
-        llvm::orc::MangleAndInterner mangle(llvmJit->getMainJITDylib().getExecutionSession(),
-                                            llvmJit->getDataLayout());
-        llvm::orc::SymbolMap symbols;
-
-        constexpr const char *const name = "print";
-        auto printProto = std::make_unique<ProtoFunctionStatement>(name, std::vector<std::string>{"param"});
-        functionProtos[name] = std::move(printProto);
-        symbols[mangle(name)] = {
-            llvm::orc::ExecutorAddr::fromPtr<double(double)>(&print),
-            llvm::JITSymbolFlags()
-        };
-
-        ExitOnError(llvmJit->getMainJITDylib().define(absoluteSymbols(std::move(symbols))));
+        HostFunctions hostFunctions;
+        hostFunctions.add("print", static_cast<double (*)(double)>(&print), false);
+        for (const auto &path: builtinBitcodeFiles) {
+            const auto bitcode = ExitOnError(llvm::errorOrToExpected(llvm::MemoryBuffer::getFile(path)));
+            ExitOnError(hostFunctions.addBitcode(bitcode->getMemBufferRef()));
+        }
+        hostFunctions.declare(functionProtos);
+        ExitOnError(hostFunctions.define(*llvmJit));
     }
 
     void testParseBinExpression();
@@ -484,24 +502,134 @@ namespace {
     void testVarDefinition();
 
     void testIfExpression();
+
+    void testForLoopExpression();
+
+    void testTypeInference();
+
+    void benchLoopKernel();
+
+    void benchModuleCompile();
+
+    void benchLazyStartup();
+
+    void benchParallelCompile();
+
+    void benchParallelCodegen();
+
+    void benchObjectCache();
+
+    void benchJitMemory();
+
+    void benchCodeEviction();
+
+    void benchProfileGuided();
+
+    void benchHostFunctions();
+
+    void benchMathBuiltins();
+
+    void benchBatchEvaluation();
+
+    void benchParallelFor();
+
+    void benchReductions();
+
+    void benchWholeProgram();
+
+    void benchPureCalls();
+
+    void benchFastMath();
+
+    void benchGlobals();
+
+    void testParallelCodegen();
+
+    void testProfileInstrumentation();
+
+    void testMathBuiltins();
+
+    void testWholeProgram();
+
+    void testSpeculativeGlobals();
+
+    void testPurityInference();
+
+    void testFastMath();
 } // namespace
 
-int main() {
+int main(int argc, char *argv[]) {
+    llvm::cl::ParseCommandLineOptions(argc, argv, "simple_ast_parser\n");
+
     testParseBinExpression();
     testParseNumber();
     testFunctionDefinition();
     testIdentifier();
     testVarDefinition();
     testIfExpression();
+    testForLoopExpression();
+    testTypeInference();
+    testParallelCodegen();
+    testProfileInstrumentation();
+    testMathBuiltins();
+    testPurityInference();
+    testFastMath();
 
     llvm::InitializeNativeTarget();
     llvm::InitializeNativeTargetAsmPrinter();
     llvm::InitializeNativeTargetAsmParser();
-    llvmJit = ExitOnError(llvm::orc::KaleidoscopeJIT::Create());
+
+    std::unique_ptr<std::istream> script;
+    if (!inputFile.empty()) {
+        auto file = std::make_unique<std::ifstream>(inputFile);
+        if (!*file) {
+            std::cerr << "can't open " << inputFile << "\n";
+            return 1;
+        }
+        script = std::move(file);
+    }
+
+    if (aheadOfTime) {
+        if (script == nullptr) {
+            std::cerr << "--aot requires a script\n";
+            return 1;
+        }
+        compileScriptAheadOfTime(std::make_unique<Lexer>(std::move(script)));
+        return 0;
+    }
+
+    llvmJit = ExitOnError(llvm::orc::KaleidoscopeJIT::Create(jitOptionsFromCommandLine()));
+    targetMachine = ExitOnError(llvmJit->createTargetMachine());
+    // Needs the target machine, unlike the tests above.
+    testWholeProgram();
 
     initLlvmModules();
 
     defineEmbeddedFunctions();
+    // Runs a script through mainHandler, which needs the JIT and the host functions.
+    testSpeculativeGlobals();
+
+    if (runBenchmarks) {
+        benchLoopKernel();
+        benchModuleCompile();
+        benchLazyStartup();
+        benchParallelCompile();
+        benchParallelCodegen();
+        benchObjectCache();
+        benchJitMemory();
+        benchCodeEviction();
+        benchProfileGuided();
+        benchHostFunctions();
+        benchMathBuiltins();
+        benchBatchEvaluation();
+        benchParallelFor();
+        benchReductions();
+        benchWholeProgram();
+        benchPureCalls();
+        benchFastMath();
+        benchGlobals();
+        return 0;
+    }
 
     const auto parser = std::make_unique<Parser>(std::make_unique<Lexer>(
         std::make_unique<std::istringstream>("1+2*3; 1*2+3;")));
@@ -514,10 +642,23 @@ int main() {
         }
     }
 
+    if (script != nullptr) {
+        mainHandler(std::make_unique<Lexer>(std::move(script)));
+        return 0;
+    }
+
     const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(R"(
         i1 = 1;
         i2 = 2;
         print(i1+i2);
+        def sumTo(n) {
+            s = 0;
+            for (i = 0, i < n, ++i) {
+                s = s + i;
+            }
+            s;
+        }
+        print(sumTo(10) + i2);
     )"));
 
     // auto stream = std::make_unique<std::istringstream>();
@@ -583,10 +724,22 @@ namespace {
             throw std::logic_error(makeTestFailMsg(__LINE__));
         }
         const auto *const numberAst = dynamic_cast<const NumberNode *>(expr.get());
-        if (numberAst->value != -123.123) {
+        if (numberAst->value != -123.123 || numberAst->isInteger) {
             throw std::logic_error(makeTestFailMsg(__LINE__));
         }
         print(expr.get());
+        // Integer literals beyond the 64-bit range are doubles.
+        for (const auto &[source, isInteger]: {std::pair{"9223372036854774784;", true},
+                                               std::pair{"9223372036854775807;", false},
+                                               std::pair{"-10000000000000000000;", false}}) {
+            const auto numberLexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(source));
+            numberLexer->readNextToken();
+            const auto number = parseExpr(numberLexer);
+            const auto *const numberNode = dynamic_cast<const NumberNode *>(number.get());
+            if (numberNode == nullptr || numberNode->isInteger != isInteger) {
+                throw std::logic_error(makeTestFailMsg(__LINE__));
+            }
+        }
     }
 
     void testParseBinExpression() {
@@ -770,4 +923,1086 @@ namespace {
             }
         }
     }
+
+    void testForLoopExpression() {
+        const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(R"(
+            for (i = 0, i < 10, ++i) {
+                s = s + i;
+                t = s;
+            }
+        )"));
+        lexer->readNextToken();
+        const auto forLoop = parseAstNodeItem(lexer);
+        const auto *const forLoopPtr = dynamic_cast<ForLoopNode *>(forLoop.get());
+        if (forLoopPtr == nullptr) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        const auto *const initPtr = dynamic_cast<VariableDefinitionStatement *>(forLoopPtr->init.get());
+        if (initPtr == nullptr || initPtr->name != "i") {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        if (forLoopPtr->conditional == nullptr || forLoopPtr->next == nullptr) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        if (forLoopPtr->body.size() != 2) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        const auto *const lastPtr = dynamic_cast<VariableDefinitionStatement *>(forLoopPtr->body.back().get());
+        if (lastPtr == nullptr || lastPtr->name != "t") {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+    }
+
+    // Names of the loop hints attached to the loops of the function, e.g. llvm.loop.isvectorized.
+    std::string describeLoops(const llvm::Function &function) {
+        std::string description;
+        for (const auto &block: function) {
+            const auto *const loopID = block.getTerminator()->getMetadata(llvm::LLVMContext::MD_loop);
+            if (loopID == nullptr) {
+                continue;
+            }
+            for (const auto &operand: loopID->operands()) {
+                const auto *const hint = llvm::dyn_cast_or_null<llvm::MDNode>(operand.get());
+                if (hint == nullptr || hint == loopID || hint->getNumOperands() == 0) {
+                    continue;
+                }
+                if (const auto *const name = llvm::dyn_cast<llvm::MDString>(hint->getOperand(0))) {
+                    description.append(name->getString()).append(" ");
+                }
+            }
+        }
+        return description;
+    }
+
+    void benchLoopKernel() {
+        constexpr auto iterations = 100'000'000.0;
+        // The kernel is optimized here rather than in the JIT, so that its loop hints can be inspected.
+        auto options = jitOptionsFromCommandLine();
+        options.optimizeIR = false;
+        const auto jit = ExitOnError(llvm::orc::KaleidoscopeJIT::Create(options));
+        for (const bool optimize: {false, true}) {
+            const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(R"(
+                def loopKernel(n) {
+                    s = 0;
+                    for (i = 0, i < n, ++i) {
+                        s = s + i * 0.5;
+                    }
+                    s;
+                }
+            )"));
+            lexer->readNextToken();
+            const auto definition = parseFunctionDefinition(lexer);
+            auto *const function = llvm::cast<llvm::Function>(generateIR(definition.get(),
+                                                                          llvmContext,
+                                                                          llvmIRBuilder,
+                                                                          llvmModule,
+                                                                          functionProtos,
+                                                                          namedValues));
+            if (optimize) {
+                optimizeModule(*llvmModule, *targetMachine);
+            }
+            const auto loops = describeLoops(*function);
+            const auto resourceTracker = jit->getMainJITDylib().createResourceTracker();
+            ExitOnError(jit->addModule(
+                llvm::orc::ThreadSafeModule(std::move(llvmModule), std::move(llvmContext)), resourceTracker));
+            initLlvmModules();
+            auto *const kernel = ExitOnError(jit->lookup("loopKernel")).getAddress().toPtr<double (*)(double)>();
+
+            const auto start = std::chrono::steady_clock::now();
+            const double result = kernel(iterations);
+            const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "loopKernel " << (optimize ? "optimized" : "unoptimized")
+                    << ": " << elapsed.count() / iterations << " ns/iteration"
+                    << ", result=" << result
+                    << ", loop hints: " << (loops.empty() ? "none" : loops) << "\n";
+            ExitOnError(resourceTracker->remove());
+        }
+    }
+
+    // Compile latency of a module per top-level def, with a fresh target machine per module and with a reused one.
+    void benchModuleCompile() {
+        constexpr auto modules = 1000;
+        llvm::orc::ConcurrentIRCompiler concurrentCompiler(llvmJit->getTargetMachineBuilder());
+        llvm::orc::CachedIRCompiler cachedCompiler(llvmJit->getTargetMachineBuilder());
+        for (auto *const compiler: std::initializer_list<llvm::orc::IRCompileLayer::IRCompiler *>{
+                 &concurrentCompiler, &cachedCompiler
+             }) {
+            std::chrono::duration<double, std::micro> elapsed{0};
+            for (auto i = 0; i < modules; ++i) {
+                const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(
+                    "def f" + std::to_string(i) + "(x) { x * 2 + " + std::to_string(i) + "; }"));
+                lexer->readNextToken();
+                const auto definition = parseFunctionDefinition(lexer);
+                generateIR(definition.get(), llvmContext, llvmIRBuilder, llvmModule, functionProtos, namedValues);
+                optimizeModule(*llvmModule, *targetMachine);
+                const llvm::orc::ThreadSafeModule module(std::move(llvmModule), std::move(llvmContext));
+                initLlvmModules();
+
+                const auto start = std::chrono::steady_clock::now();
+                ExitOnError(module.withModuleDo(*compiler));
+                elapsed += std::chrono::steady_clock::now() - start;
+            }
+            std::cout << "moduleCompile " << (compiler == &cachedCompiler ? "cached" : "concurrent")
+                    << ": " << elapsed.count() / modules << " us/module\n";
+        }
+    }
+
+    // Time to add many defs and call one of them, with every def compiled up front and with compilation on first call.
+    void benchLazyStartup() {
+        constexpr auto definitions = 300;
+        for (const bool lazy: {false, true}) {
+            auto options = jitOptionsFromCommandLine();
+            options.lazyCompilation = lazy;
+            const auto jit = ExitOnError(llvm::orc::KaleidoscopeJIT::Create(options));
+
+            const auto start = std::chrono::steady_clock::now();
+            for (auto i = 0; i < definitions; ++i) {
+                // Each helper references the previous one on a path that is never taken, so eager linking pulls in
+                // the whole chain while the lazy mode compiles only the called helper.
+                const auto index = std::to_string(i);
+                const auto fallback = i == 0 ? std::string("0") : "helper" + std::to_string(i - 1) + "(n)";
+                const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(
+                    "def helper" + index + "(n) { s = 0; if (n < 0) { s = " + fallback + "; }"
+                    " for (i = 0, i < n, ++i) { s = s + i * " + index + "; } s; }"));
+                lexer->readNextToken();
+                const auto definition = parseFunctionDefinition(lexer);
+                generateIR(definition.get(), llvmContext, llvmIRBuilder, llvmModule, functionProtos, namedValues);
+                ExitOnError(jit->addLazyModule(
+                    llvm::orc::ThreadSafeModule(std::move(llvmModule), std::move(llvmContext)), nullptr));
+                initLlvmModules();
+            }
+            auto *const helper = ExitOnError(jit->lookup("helper" + std::to_string(definitions - 1))).getAddress().toPtr<double (*)(double)>();
+            const double result = helper(10);
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "lazyStartup " << (lazy ? "lazy" : "eager") << ": " << elapsed.count() << " ms for "
+                    << definitions << " defs, result=" << result << "\n";
+        }
+    }
+
+    // Time to optimize and compile many independent defs, which are all linked by a single lookup.
+    void benchParallelCompile() {
+        constexpr auto definitions = 2000;
+        std::string caller = "def callAll(n) { s = 0;";
+        std::vector<llvm::orc::ThreadSafeModule> modules;
+        for (auto i = 0; i < definitions; ++i) {
+            const auto index = std::to_string(i);
+            caller.append(" s = s + work" + index + "(n);");
+            const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(
+                "def work" + index + "(n) { s = 0; for (i = 0, i < n, ++i) { s = s + i * " + index + "; } s; }"));
+            lexer->readNextToken();
+            const auto definition = parseFunctionDefinition(lexer);
+            generateIR(definition.get(), llvmContext, llvmIRBuilder, llvmModule, functionProtos, namedValues);
+            modules.emplace_back(std::move(llvmModule), std::move(llvmContext));
+            initLlvmModules();
+        }
+        caller.append(" s; }");
+        const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(caller));
+        lexer->readNextToken();
+        const auto definition = parseFunctionDefinition(lexer);
+        generateIR(definition.get(), llvmContext, llvmIRBuilder, llvmModule, functionProtos, namedValues);
+        modules.emplace_back(std::move(llvmModule), std::move(llvmContext));
+        initLlvmModules();
+
+        for (const unsigned threads: {0U, static_cast<unsigned>(compileThreads)}) {
+            auto options = jitOptionsFromCommandLine();
+            options.lazyCompilation = false;
+            options.compileThreads = threads;
+            const auto jit = ExitOnError(llvm::orc::KaleidoscopeJIT::Create(options));
+
+            // Every configuration compiles its own copy of the same modules.
+            std::vector<llvm::orc::ThreadSafeModule> copies;
+            for (const auto &module: modules) {
+                copies.push_back(llvm::orc::cloneToNewContext(module));
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+            for (auto &copy: copies) {
+                ExitOnError(jit->addModule(std::move(copy), nullptr));
+            }
+            auto *const callAll = ExitOnError(jit->lookup("callAll")).getAddress().toPtr<double (*)(double)>();
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "parallelCompile " << (threads == 0 ? "in-place" : std::to_string(threads) + " threads")
+                    << ": " << elapsed.count() << " ms for "
+                    << definitions + 1 << " modules, result=" << callAll(10) << "\n";
+        }
+    }
+
+    // Front end to machine code: IR generation of many defs on one and on several threads, then JIT compilation.
+    void benchParallelCodegen() {
+        constexpr auto definitions = 2000;
+        std::string caller = "def callAll(n) { s = 0;";
+        std::vector<std::unique_ptr<FunctionNode> > parsedDefinitions;
+        for (auto i = 0; i < definitions; ++i) {
+            const auto index = std::to_string(i);
+            caller.append(" s = s + kernel" + index + "(n);");
+            const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(
+                "def kernel" + index + "(n) { s = 0; for (i = 0, i < n, ++i) { s = s + i * " + index + "; } s; }"));
+            lexer->readNextToken();
+            parsedDefinitions.push_back(parseFunctionDefinition(lexer));
+        }
+        caller.append(" s; }");
+        const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(caller));
+        lexer->readNextToken();
+        parsedDefinitions.push_back(parseFunctionDefinition(lexer));
+        std::vector<const FunctionNode *> functions;
+        for (const auto &definition: parsedDefinitions) {
+            functions.push_back(definition.get());
+        }
+
+        for (const unsigned threads: {1U, static_cast<unsigned>(codegenThreads)}) {
+            auto options = jitOptionsFromCommandLine();
+            options.lazyCompilation = false;
+            const auto jit = ExitOnError(llvm::orc::KaleidoscopeJIT::Create(options));
+
+            const auto start = std::chrono::steady_clock::now();
+            auto modules = generateModules(functions,
+                                           functionProtos,
+                                           jit->getDataLayout(),
+                                           targetMachine->getTargetTriple().str(),
+                                           threads);
+            const std::chrono::duration<double, std::milli> codegenElapsed = std::chrono::steady_clock::now() - start;
+            for (auto &module: modules) {
+                ExitOnError(jit->addModule(std::move(module), nullptr));
+            }
+            auto *const callAll = ExitOnError(jit->lookup("callAll")).getAddress().toPtr<double (*)(double)>();
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "parallelCodegen " << threads << " threads: codegen " << codegenElapsed.count()
+                    << " ms, total " << elapsed.count() << " ms for " << functions.size() << " defs, result="
+                    << callAll(10) << "\n";
+        }
+    }
+
+    // Cold and warm start of the same script with a persistent object cache.
+    void benchObjectCache() {
+        constexpr auto definitions = 300;
+        llvm::SmallString<128> cacheDir;
+        if (llvm::sys::fs::createUniqueDirectory("simple_ast_parser-cache", cacheDir)) {
+            return;
+        }
+        std::vector<std::unique_ptr<FunctionNode> > parsedDefinitions;
+        std::vector<const FunctionNode *> functions;
+        for (auto i = 0; i < definitions; ++i) {
+            const auto index = std::to_string(i);
+            const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(
+                "def cached" + index + "(n) { s = 0; for (i = 0, i < n, ++i) { s = s + i * " + index + "; } s; }"));
+            lexer->readNextToken();
+            parsedDefinitions.push_back(parseFunctionDefinition(lexer));
+            functions.push_back(parsedDefinitions.back().get());
+        }
+
+        for (const auto *const start: {"cold", "warm"}) {
+            auto options = jitOptionsFromCommandLine();
+            options.lazyCompilation = false;
+            options.objectCacheDir = std::string(cacheDir);
+            const auto jit = ExitOnError(llvm::orc::KaleidoscopeJIT::Create(options));
+
+            const auto begin = std::chrono::steady_clock::now();
+            for (auto &module: generateModules(functions,
+                                               functionProtos,
+                                               jit->getDataLayout(),
+                                               targetMachine->getTargetTriple().str(),
+                                               codegenThreads)) {
+                ExitOnError(jit->addModule(std::move(module), nullptr));
+            }
+            double result = 0;
+            for (auto i = 0; i < definitions; ++i) {
+                result += ExitOnError(jit->lookup("cached" + std::to_string(i))).getAddress()
+                        .toPtr<double (*)(double)>()(10);
+            }
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+            std::cout << "objectCache " << start << ": " << elapsed.count() << " ms for " << definitions
+                    << " defs, backend runs=" << jit->getObjectCache()->misses()
+                    << ", cache hits=" << jit->getObjectCache()->hits() << ", result=" << result << "\n";
+        }
+        llvm::sys::fs::remove_directories(cacheDir);
+    }
+
+    // Many tiny modules as in an interactive session: every def stays linked, every top-level expression is removed
+    // after it runs. RuntimeDyld maps pages per object while JITLink packs the objects into the slabs.
+    void benchJitMemory() {
+        constexpr auto expressions = 2000;
+        for (const bool useJitLink: {false, true}) {
+            auto options = jitOptionsFromCommandLine();
+            options.lazyCompilation = false;
+            options.jitLink = useJitLink;
+            const auto jit = ExitOnError(llvm::orc::KaleidoscopeJIT::Create(options));
+
+            double result = 0;
+            const auto start = std::chrono::steady_clock::now();
+            for (auto i = 0; i < expressions; ++i) {
+                const auto index = std::to_string(i);
+                const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(
+                    "def offset" + index + "(x) { x + " + index + "; } offset" + index + "(1);"));
+                lexer->readNextToken();
+                const auto definition = parseFunctionDefinition(lexer);
+                generateIR(definition.get(), llvmContext, llvmIRBuilder, llvmModule, functionProtos, namedValues);
+                ExitOnError(jit->addModule(
+                    llvm::orc::ThreadSafeModule(std::move(llvmModule), std::move(llvmContext)), nullptr));
+                initLlvmModules();
+
+                lexer->readNextToken(); // eat '}'
+                const auto expression = parseTopLevelExpr(lexer, "_start");
+                generateIR(expression.get(), llvmContext, llvmIRBuilder, llvmModule, functionProtos, namedValues);
+                const auto resourceTracker = jit->getMainJITDylib().createResourceTracker();
+                ExitOnError(jit->addModule(
+                    llvm::orc::ThreadSafeModule(std::move(llvmModule), std::move(llvmContext)), resourceTracker));
+                initLlvmModules();
+                result += ExitOnError(jit->lookup("_start")).getAddress().toPtr<double (*)()>()();
+                ExitOnError(resourceTracker->remove());
+            }
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "jitMemory " << (useJitLink ? "jitlink" : "rtdyld") << ": " << elapsed.count() << " ms for "
+                    << expressions << " defs and expressions, result=" << result << "\n";
+            if (const auto *const memoryMapper = jit->getMemoryMapper()) {
+                printMemoryStats(memoryMapper->getStats());
+            }
+        }
+    }
+
+    // Script churn in a long-running session: every round defines a new function and calls it together with a hot
+    // function defined up front. Under the memory limit the linked code stays flat while the hot function survives.
+    void benchCodeEviction() {
+        constexpr auto rounds = 2000;
+        for (const std::uint64_t memoryLimit: {std::uint64_t{0}, std::uint64_t{256 * 1024}}) {
+            auto options = jitOptionsFromCommandLine();
+            options.lazyCompilation = false;
+            options.jitLink = true;
+            options.memoryLimit = memoryLimit;
+            const auto jit = ExitOnError(llvm::orc::KaleidoscopeJIT::Create(options));
+
+            auto addDefinition = [&jit](const std::string &source) {
+                const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(source));
+                lexer->readNextToken();
+                const auto definition = parseFunctionDefinition(lexer);
+                generateIR(definition.get(), llvmContext, llvmIRBuilder, llvmModule, functionProtos, namedValues);
+                ExitOnError(jit->addLazyModule(
+                    llvm::orc::ThreadSafeModule(std::move(llvmModule), std::move(llvmContext)), nullptr));
+                initLlvmModules();
+            };
+            addDefinition("def hot(n) { s = 0; for (i = 0, i < n, ++i) { s = s + i; } s; }");
+
+            double result = 0;
+            std::uint64_t peakBytes = 0;
+            const auto start = std::chrono::steady_clock::now();
+            for (auto i = 0; i < rounds; ++i) {
+                const auto index = std::to_string(i);
+                addDefinition("def churn" + index + "(x) { hot(x) + " + index + "; }");
+                auto *const churn = ExitOnError(jit->lookup("churn" + index)).getAddress().toPtr<double (*)(double)>();
+                result += churn(10);
+                peakBytes = std::max(peakBytes, jit->getMemoryMapper()->getStats().usedBytes);
+                ExitOnError(jit->evictColdFunctions());
+            }
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "codeEviction " << (memoryLimit == 0 ? "unlimited" : std::to_string(memoryLimit) + " bytes")
+                    << ": " << elapsed.count() << " ms for " << rounds << " rounds, peak=" << peakBytes
+                    << " bytes, result=" << result << "\n";
+            printMemoryStats(jit->getMemoryMapper()->getStats());
+            if (const auto *const evictionManager = jit->getEvictionManager()) {
+                std::cout << "eviction: compilations=" << evictionManager->compilations()
+                        << ", evictions=" << evictionManager->evictions() << "\n";
+            }
+        }
+    }
+
+    // A scoring function whose branches are heavily skewed, compiled with static heuristics and again after a
+    // warm-up with the profile of the instrumented code.
+    void benchProfileGuided() {
+        constexpr auto warmupCalls = 100;
+        constexpr auto calls = 100'000;
+        for (const std::uint64_t profileWarmupCalls: {std::uint64_t{0}, std::uint64_t{warmupCalls}}) {
+            auto options = jitOptionsFromCommandLine();
+            options.lazyCompilation = false;
+            options.memoryLimit = 0;
+            options.profileWarmupCalls = profileWarmupCalls;
+            const auto jit = ExitOnError(llvm::orc::KaleidoscopeJIT::Create(options));
+
+            const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(R"(
+                def score(n) {
+                    s = 0;
+                    for (i = 0, i < n, ++i) {
+                        if (i > 997) {
+                            s = s + i * i / 3;
+                        } else {
+                            if (s > 1000000) {
+                                s = s - 1000000;
+                            } else {
+                                s = s + i;
+                            }
+                        }
+                    }
+                    s;
+                }
+            )"));
+            lexer->readNextToken();
+            const auto definition = parseFunctionDefinition(lexer);
+            generateIR(definition.get(), llvmContext, llvmIRBuilder, llvmModule, functionProtos, namedValues);
+            ExitOnError(jit->addLazyModule(
+                llvm::orc::ThreadSafeModule(std::move(llvmModule), std::move(llvmContext)), nullptr));
+            initLlvmModules();
+            // Calls go through the stub, which points at the optimized body after reoptimizeHotFunctions().
+            auto *const score = ExitOnError(jit->lookup("score")).getAddress().toPtr<double (*)(double)>();
+            double result = 0;
+            for (auto i = 0; i < warmupCalls; ++i) {
+                result += score(1000);
+            }
+            ExitOnError(jit->reoptimizeHotFunctions());
+
+            const auto start = std::chrono::steady_clock::now();
+            for (auto i = 0; i < calls; ++i) {
+                result += score(1000);
+            }
+            const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "profileGuided " << (profileWarmupCalls == 0 ? "static" : "profiled") << ": "
+                    << elapsed.count() / calls << " us/call, result=" << result;
+            if (const auto *const profileGuidedOptimizer = jit->getProfileGuidedOptimizer()) {
+                std::cout << ", reoptimizations=" << profileGuidedOptimizer->reoptimizations();
+            }
+            std::cout << "\n";
+        }
+    }
+
+    double hostSquare(const double x) {
+        return x * x;
+    }
+
+    // A loop calling a tiny helper, bound as a native host function and linked into the module as a bitcode builtin.
+    void benchHostFunctions() {
+        constexpr auto iterations = 10'000'000.0;
+        // The builtin is a def compiled to bitcode by the front end itself.
+        std::string bitcode;
+        {
+            const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(
+                "def square(x) { x * x; }"));
+            lexer->readNextToken();
+            const auto definition = parseFunctionDefinition(lexer);
+            std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > protos;
+            generateIR(definition.get(), llvmContext, llvmIRBuilder, llvmModule, protos, namedValues);
+            llvm::raw_string_ostream os(bitcode);
+            llvm::WriteBitcodeToFile(*llvmModule, os);
+            initLlvmModules();
+        }
+        for (const bool inlinable: {false, true}) {
+            auto options = jitOptionsFromCommandLine();
+            options.lazyCompilation = false;
+            options.searchProcessSymbols = false;
+            const auto jit = ExitOnError(llvm::orc::KaleidoscopeJIT::Create(options));
+            HostFunctions hostFunctions;
+            if (inlinable) {
+                ExitOnError(hostFunctions.addBitcode(llvm::MemoryBufferRef(bitcode, "square")));
+            } else {
+                hostFunctions.add("square", &hostSquare, true);
+            }
+            std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > protos;
+            hostFunctions.declare(protos);
+            ExitOnError(hostFunctions.define(*jit));
+
+            const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(
+                "def sumSquares(n) { s = 0; for (i = 0, i < n, ++i) { s = s + square(i * 0.5); } s; }"));
+            lexer->readNextToken();
+            const auto definition = parseFunctionDefinition(lexer);
+            generateIR(definition.get(), llvmContext, llvmIRBuilder, llvmModule, protos, namedValues);
+            ExitOnError(jit->addModule(
+                llvm::orc::ThreadSafeModule(std::move(llvmModule), std::move(llvmContext)), nullptr));
+            initLlvmModules();
+            auto *const sumSquares = ExitOnError(jit->lookup("sumSquares")).getAddress().toPtr<double (*)(double)>();
+
+            const auto start = std::chrono::steady_clock::now();
+            const double result = sumSquares(iterations);
+            const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "hostFunctions " << (inlinable ? "bitcode" : "native") << ": "
+                    << elapsed.count() / iterations << " ns/call, result=" << result << "\n";
+        }
+    }
+
+    double hostSqrt(const double x) {
+        return std::sqrt(x);
+    }
+
+    // A loop over sqrt, called as an opaque host function and lowered to llvm.sqrt.
+    void benchMathBuiltins() {
+        constexpr auto iterations = 10'000'000.0;
+        for (const bool intrinsic: {false, true}) {
+            auto options = jitOptionsFromCommandLine();
+            options.lazyCompilation = false;
+            options.searchProcessSymbols = false;
+            const auto jit = ExitOnError(llvm::orc::KaleidoscopeJIT::Create(options));
+            std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > protos;
+            if (!intrinsic) {
+                // A host function takes precedence over the builtin of the same name.
+                HostFunctions hostFunctions;
+                hostFunctions.add("sqrt", &hostSqrt, true);
+                hostFunctions.declare(protos);
+                ExitOnError(hostFunctions.define(*jit));
+            }
+
+            const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(
+                "def sumNorms(n) { s = 0; for (i = 0, i < n, ++i) { s = s + sqrt(i * i + 1); } s; }"));
+            lexer->readNextToken();
+            const auto definition = parseFunctionDefinition(lexer);
+            generateIR(definition.get(), llvmContext, llvmIRBuilder, llvmModule, protos, namedValues);
+            ExitOnError(jit->addModule(
+                llvm::orc::ThreadSafeModule(std::move(llvmModule), std::move(llvmContext)), nullptr));
+            initLlvmModules();
+            auto *const sumNorms = ExitOnError(jit->lookup("sumNorms")).getAddress().toPtr<double (*)(double)>();
+
+            const auto start = std::chrono::steady_clock::now();
+            const double result = sumNorms(iterations);
+            const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "mathBuiltins " << (intrinsic ? "intrinsic" : "call") << ": "
+                    << elapsed.count() / iterations << " ns/iteration, result=" << result << "\n";
+        }
+    }
+
+    // A three-argument formula over columns of rows, called per row through a pointer and as one batch kernel.
+    void benchBatchEvaluation() {
+        constexpr std::size_t rows = 10'000'000;
+        auto engine = ExitOnError(Engine::Create());
+        ExitOnError(engine->compile("def score(a, b, c) { fma(a, b, sqrt(c)) * 0.5; }"));
+        auto *const score = ExitOnError(engine->lookup<double(double, double, double)>("score"));
+        auto *const scoreBatch = ExitOnError(engine->lookupBatch("score"));
+        std::vector<double> a(rows);
+        std::vector<double> b(rows);
+        std::vector<double> c(rows);
+        for (std::size_t row = 0; row < rows; ++row) {
+            a[row] = static_cast<double>(row % 1000);
+            b[row] = 0.25;
+            c[row] = static_cast<double>(row % 97);
+        }
+        const double *const columns[] = {a.data(), b.data(), c.data()};
+        std::vector<double> out(rows);
+
+        const auto report = [](const char *const mode, const auto start, const double checksum) {
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "batchEvaluation " << mode << ": " << static_cast<double>(rows) / elapsed.count() / 1e6
+                    << " Mrows/s, checksum=" << checksum << "\n";
+        };
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t row = 0; row < rows; ++row) {
+            out[row] = score(a[row], b[row], c[row]);
+        }
+        report("per row", start, out[rows / 2]);
+        start = std::chrono::steady_clock::now();
+        scoreBatch(columns, out.data(), rows);
+        report("batch", start, out[rows / 2]);
+    }
+
+    // A scoring loop over an array, run by for and by parfor on every core.
+    void benchParallelFor() {
+        std::vector<double> out(4'000'000);
+        auto engine = ExitOnError(Engine::Create());
+        ExitOnError(engine->compile(R"(
+            def scoreSerial(out[]) {
+                for (i = 0, i < len(out), ++i) { x = i * 0.000001; out[i] = sqrt(x) * exp(0 - x) + sin(x); }
+                0;
+            }
+            def scoreParallel(out[]) {
+                parfor (i = 0, i < len(out)) { x = i * 0.000001; out[i] = sqrt(x) * exp(0 - x) + sin(x); }
+                0;
+            }
+        )"));
+        for (const auto *const name: {"scoreSerial", "scoreParallel"}) {
+            auto *const score = ExitOnError(engine->lookup<double(double *, std::size_t)>(name));
+            score(out.data(), out.size());
+            const auto start = std::chrono::steady_clock::now();
+            score(out.data(), out.size());
+            const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "parallelFor " << name << ": " << elapsed.count() / static_cast<double>(out.size())
+                    << " ns/iteration, checksum=" << out[out.size() / 2] << "\n";
+        }
+    }
+
+    // A dot product accumulated by a for loop in program order, by sum and by parsum.
+    void benchReductions() {
+        std::vector<double> a(8'000'000);
+        std::vector<double> b(a.size());
+        for (std::size_t i = 0; i < a.size(); ++i) {
+            a[i] = static_cast<double>(i % 1000) * 0.001;
+            b[i] = static_cast<double>(i % 7);
+        }
+        auto engine = ExitOnError(Engine::Create());
+        ExitOnError(engine->compile(R"(
+            def dotLoop(a[], b[]) { s = 0.0; for (i = 0, i < len(a), ++i) { s = s + a[i] * b[i]; } s; }
+            def dotSum(a[], b[]) { sum(i = 0, len(a)) { a[i] * b[i] }; }
+            def dotParallel(a[], b[]) { parsum(i = 0, len(a)) { a[i] * b[i] }; }
+        )"));
+        for (const auto *const name: {"dotLoop", "dotSum", "dotParallel"}) {
+            auto *const dot = ExitOnError(
+                engine->lookup<double(const double *, std::size_t, const double *, std::size_t)>(name));
+            dot(a.data(), a.size(), b.data(), b.size());
+            const auto start = std::chrono::steady_clock::now();
+            const double result = dot(a.data(), a.size(), b.data(), b.size());
+            const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "reductions " << name << ": " << elapsed.count() / static_cast<double>(a.size())
+                    << " ns/element, result=" << result << "\n";
+        }
+    }
+
+    // A kernel calling small helpers, with a module per def and as a whole program.
+    void benchWholeProgram() {
+        const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(R"(
+            def clamp01(x) { if (x < 0) { 0; } else { if (x > 1) { 1; } else { x; } } }
+            def smoothstep(x) { y = clamp01(x); y * y * (3 - 2 * y); }
+            def kernel(n) { s = 0.0; for (i = 0, i < n, ++i) { s = s + smoothstep(i * 0.0000002); } s; }
+        )"));
+        std::vector<std::unique_ptr<FunctionNode> > definitions;
+        lexer->readNextToken();
+        while (lexer->getCurrentToken() == TokenType::FunctionDefinitionToken) {
+            definitions.push_back(parseFunctionDefinition(lexer));
+            lexer->readNextToken(); // eat '}'
+        }
+        std::vector<const FunctionNode *> functions;
+        for (const auto &definition: definitions) {
+            functions.push_back(definition.get());
+        }
+
+        for (const bool whole: {false, true}) {
+            auto options = jitOptionsFromCommandLine();
+            options.lazyCompilation = false;
+            const auto jit = ExitOnError(llvm::orc::KaleidoscopeJIT::Create(options));
+            std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > protos;
+            const auto triple = targetMachine->getTargetTriple().str();
+            if (whole) {
+                auto module = generateModule(functions, protos, jit->getDataLayout(), triple);
+                module.withModuleDo([](llvm::Module &m) {
+                    optimizeWholeProgram(m, *targetMachine, [](const llvm::GlobalValue &value) {
+                        return value.getName() == "kernel";
+                    });
+                });
+                ExitOnError(jit->addModule(std::move(module), nullptr));
+            } else {
+                for (auto &module: generateModules(functions, protos, jit->getDataLayout(), triple, 1)) {
+                    ExitOnError(jit->addModule(std::move(module), nullptr));
+                }
+            }
+            auto *const kernel = ExitOnError(jit->lookup("kernel")).getAddress().toPtr<double (*)(double)>();
+            kernel(1000);
+            const auto start = std::chrono::steady_clock::now();
+            const double result = kernel(10'000'000);
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "wholeProgram " << (whole ? "whole program" : "module per def") << ": " << elapsed.count()
+                    << " ms, result=" << result << "\n";
+        }
+    }
+
+    // A formula calling a pure def three times with the same argument, against a single call: GVN merges the calls.
+    void benchPureCalls() {
+        auto engine = ExitOnError(Engine::Create());
+        ExitOnError(engine->compile(R"(
+            def wave(x) { s = 0; for (i = 0, i < 200, ++i) { s = s + sin(x * i); } s; }
+            def single(x) { wave(x); }
+            def formula(x) { wave(x) * wave(x) + wave(x); }
+        )"));
+        for (const auto *const name: {"single", "formula"}) {
+            auto *const function = ExitOnError(engine->lookup<double(double)>(name));
+            constexpr auto calls = 100'000;
+            double checksum = 0;
+            const auto start = std::chrono::steady_clock::now();
+            for (auto i = 0; i < calls; ++i) {
+                checksum += function(i * 0.001);
+            }
+            const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "pureCalls " << name << ": " << elapsed.count() / calls << " ns/call, checksum=" << checksum
+                    << "\n";
+        }
+    }
+
+    // A Horner polynomial and a sum over an array, under the default strict semantics and with all fast-math flags.
+    void benchFastMath() {
+        std::vector<double> x(4'000'000);
+        std::vector<double> out(x.size());
+        for (std::size_t i = 0; i < x.size(); ++i) {
+            x[i] = static_cast<double>(i % 1000) * 0.001;
+        }
+        constexpr auto source = R"(
+            def horner(x[], out[]) {
+                for (i = 0, i < len(x), ++i) { t = x[i]; out[i] = (((0.1 * t + 0.2) * t + 0.3) * t + 0.4) * t + 0.5; }
+                0;
+            }
+            def total(a[]) { s = 0.0; for (i = 0, i < len(a), ++i) { s = s + a[i]; } s; }
+        )";
+        for (const bool fast: {false, true}) {
+            EngineOptions options;
+            if (fast) {
+                options.fastMath.set("fast");
+            }
+            auto engine = ExitOnError(Engine::Create(options));
+            ExitOnError(engine->compile(source));
+            const auto *const mode = fast ? "fast" : "strict";
+
+            auto *const horner = ExitOnError(
+                engine->lookup<double(const double *, std::size_t, double *, std::size_t)>("horner"));
+            horner(x.data(), x.size(), out.data(), out.size());
+            auto start = std::chrono::steady_clock::now();
+            horner(x.data(), x.size(), out.data(), out.size());
+            std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "fastMath horner " << mode << ": " << elapsed.count() / static_cast<double>(x.size())
+                    << " ns/element, checksum=" << out[out.size() / 2] << "\n";
+
+            auto *const total = ExitOnError(engine->lookup<double(const double *, std::size_t)>("total"));
+            total(x.data(), x.size());
+            start = std::chrono::steady_clock::now();
+            const double result = total(x.data(), x.size());
+            elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "fastMath total " << mode << ": " << elapsed.count() / static_cast<double>(x.size())
+                    << " ns/element, result=" << result << "\n";
+        }
+    }
+
+    // Expressions using an expensive value, computing it every time against reading it from a global computed once.
+    void benchGlobals() {
+        auto engine = ExitOnError(Engine::Create());
+        ExitOnError(engine->compile(R"(
+            def expensive(n) { s = 0.0; for (i = 0, i < n, ++i) { s = s + sin(i * 0.001); } s; }
+        )"));
+        constexpr auto evaluations = 100;
+        for (const bool cached: {false, true}) {
+            const auto start = std::chrono::steady_clock::now();
+            if (cached) {
+                ExitOnError(engine->evaluate("cache = expensive(1000000);"));
+            }
+            double checksum = 0;
+            for (auto i = 0; i < evaluations; ++i) {
+                checksum += ExitOnError(engine->evaluate(cached ? "cache * 2;" : "expensive(1000000) * 2;"));
+            }
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "globals " << (cached ? "cached" : "recomputed") << ": " << elapsed.count() / evaluations
+                    << " ms/evaluation, checksum=" << checksum << "\n";
+        }
+    }
+
+    void testParallelCodegen() {
+        const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(R"(
+            def first(n) { second(n) + 1; }
+            def second(n) { n * 2; }
+            def third(n) { first(n) + second(n); }
+        )"));
+        std::vector<std::unique_ptr<FunctionNode> > definitions;
+        lexer->readNextToken();
+        while (lexer->getCurrentToken() == TokenType::FunctionDefinitionToken) {
+            definitions.push_back(parseFunctionDefinition(lexer));
+            lexer->readNextToken(); // eat '}'
+        }
+        if (definitions.size() != 3) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        std::vector<const FunctionNode *> functions;
+        for (const auto &definition: definitions) {
+            functions.push_back(definition.get());
+        }
+
+        std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > protos;
+        auto modules = generateModules(functions, protos, llvm::DataLayout(""), "", 2);
+        if (modules.size() != 3 || protos.size() != 3) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        // The first worker generates "first" and "second", the second one "third".
+        if (modules[0].getContext().getContext() != modules[1].getContext().getContext()
+            || modules[1].getContext().getContext() == modules[2].getContext().getContext()) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        std::vector<std::string> definedFunctions;
+        for (auto &module: modules) {
+            module.withModuleDo([&definedFunctions](const llvm::Module &m) {
+                for (const auto &function: m) {
+                    if (!function.isDeclaration()) {
+                        definedFunctions.emplace_back(function.getName());
+                    }
+                }
+            });
+        }
+        // "third" calls the functions of the other worker through declarations.
+        if (definedFunctions != std::vector<std::string>{"first", "second", "third"}) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+    }
+
+    void testProfileInstrumentation() {
+        const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(
+            "def branchy(n) { if (n < 1) { 1; } else { 2; } }"));
+        lexer->readNextToken();
+        const auto definition = parseFunctionDefinition(lexer);
+        std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > protos;
+        auto modules = generateModules({definition.get()}, protos, llvm::DataLayout(""), "", 1);
+        if (modules.size() != 1) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        modules.front().withModuleDo([](llvm::Module &module) {
+            auto &function = *module.getFunction("branchy");
+            // Entry, then, else and merge blocks, and the if condition.
+            if (countersOf(function) != 5) {
+                throw std::logic_error(makeTestFailMsg(__LINE__));
+            }
+            applyProfile(function, {10, 1, 9, 10, 1});
+            const auto entryCount = function.getEntryCount();
+            if (!entryCount || entryCount->getCount() != 10 || module.getProfileSummary(false) == nullptr) {
+                throw std::logic_error(makeTestFailMsg(__LINE__));
+            }
+            std::uint64_t taken = 0;
+            std::uint64_t notTaken = 0;
+            if (!llvm::extractBranchWeights(*function.getEntryBlock().getTerminator(), taken, notTaken)
+                || taken != 1 || notTaken != 9) {
+                throw std::logic_error(makeTestFailMsg(__LINE__));
+            }
+            instrumentFunction(function, "branchy.counters");
+            if (function.size() != 4 || module.getNamedGlobal("branchy.counters") == nullptr) {
+                throw std::logic_error(makeTestFailMsg(__LINE__));
+            }
+        });
+    }
+
+    void testMathBuiltins() {
+        const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(R"(
+            def max(a, b) { if (a < b) { b; } else { a; } }
+            def score(x, y) { fma(sqrt(x), min(x, y), pow(2, y)) + max(x, y); }
+        )"));
+        lexer->readNextToken();
+        const auto max = parseFunctionDefinition(lexer);
+        lexer->readNextToken();
+        const auto score = parseFunctionDefinition(lexer);
+        std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > protos;
+        auto modules = generateModules({max.get(), score.get()}, protos, llvm::DataLayout(""), "", 1);
+        if (modules.size() != 2) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        modules.back().withModuleDo([](llvm::Module &module) {
+            std::vector<llvm::Intrinsic::ID> intrinsics;
+            std::vector<std::string> calls;
+            for (const auto &instruction: llvm::instructions(*module.getFunction("score"))) {
+                if (const auto *const intrinsic = llvm::dyn_cast<llvm::IntrinsicInst>(&instruction)) {
+                    intrinsics.push_back(intrinsic->getIntrinsicID());
+                } else if (const auto *const call = llvm::dyn_cast<llvm::CallInst>(&instruction)) {
+                    calls.push_back(call->getCalledFunction()->getName().str());
+                }
+            }
+            const std::vector<llvm::Intrinsic::ID> expected{
+                llvm::Intrinsic::sqrt, llvm::Intrinsic::minnum, llvm::Intrinsic::pow, llvm::Intrinsic::fma
+            };
+            // The def named max shadows the builtin.
+            if (intrinsics != expected || calls != std::vector<std::string>{"max"}) {
+                throw std::logic_error(makeTestFailMsg(__LINE__));
+            }
+            if (!module.getFunction("llvm.sqrt.f64")->doesNotAccessMemory()) {
+                throw std::logic_error(makeTestFailMsg(__LINE__));
+            }
+        });
+    }
+
+    void testWholeProgram() {
+        const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(R"(
+            def square(x) { x * x; }
+            def norm(x, y) { sqrt(square(x) + square(y)); }
+            norm(3, 4);
+        )"));
+        lexer->readNextToken();
+        const auto square = parseFunctionDefinition(lexer);
+        lexer->readNextToken();
+        const auto norm = parseFunctionDefinition(lexer);
+        lexer->readNextToken();
+        const auto expression = parseTopLevelExpr(lexer, "wholeProgramTest");
+        std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > protos;
+        auto module = generateModule({square.get(), norm.get(), expression.get()}, protos, llvmJit->getDataLayout(),
+                                     targetMachine->getTargetTriple().str());
+        module.withModuleDo([](llvm::Module &m) {
+            optimizeWholeProgram(m, *targetMachine, [](const llvm::GlobalValue &value) {
+                return value.getName() == "wholeProgramTest";
+            });
+            // Both defs are inlined into the only export and dropped.
+            const auto *const start = m.getFunction("wholeProgramTest");
+            if (start == nullptr || !start->hasExternalLinkage() || m.getFunction("square") != nullptr
+                || m.getFunction("norm") != nullptr) {
+                throw std::logic_error(makeTestFailMsg(__LINE__));
+            }
+        });
+        const auto resourceTracker = llvmJit->getMainJITDylib().createResourceTracker();
+        ExitOnError(llvmJit->addModule(std::move(module), resourceTracker));
+        auto *const start = ExitOnError(llvmJit->lookup("wholeProgramTest")).getAddress().toPtr<double (*)()>();
+        if (start() != 5) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        ExitOnError(resourceTracker->remove());
+    }
+
+    void testSpeculativeGlobals() {
+        // With --speculate a def is generated as soon as it is parsed, unless it reads a global which only a later
+        // top-level expression assigns.
+        const bool speculative = speculativeCompilation;
+        speculativeCompilation = true;
+        std::ostringstream output;
+        auto *const coutBuffer = std::cout.rdbuf(output.rdbuf());
+        mainHandler(std::make_unique<Lexer>(std::make_unique<std::istringstream>(R"(
+            def speculativeScale(x) { x * speculativeFactor; }
+            def speculativeTwice(x) { speculativeScale(x) * 2; }
+            speculativeFactor = 3;
+            speculativeTwice(2);
+        )")));
+        std::cout.rdbuf(coutBuffer);
+        speculativeCompilation = speculative;
+        if (output.str().find("result=12\n") == std::string::npos) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+    }
+
+    void testPurityInference() {
+        const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(R"(
+            def square(x) { x * x; }
+            def loud(x) { print(x); }
+            def sumSquares(n) { s = 0; for (i = 0, i < n, ++i) { s = s + square(i); } s; }
+            def viaLoud(x) { loud(x) + square(x); }
+            def factorial(n) { if (n < 2) { 1; } else { n * factorial(n - 1); } }
+            def norm(a[]) { sqrt(sum(i = 0, len(a)) { a[i] * a[i] }); }
+            def cube(x) { x * square(x); }
+        )"));
+        std::vector<std::unique_ptr<FunctionNode> > definitions;
+        lexer->readNextToken();
+        while (lexer->getCurrentToken() == TokenType::FunctionDefinitionToken) {
+            definitions.push_back(parseFunctionDefinition(lexer));
+            lexer->readNextToken(); // eat '}'
+        }
+        std::vector<const FunctionNode *> functions;
+        for (const auto &definition: definitions) {
+            functions.push_back(definition.get());
+        }
+        std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > protos;
+        protos["print"] = std::make_unique<ProtoFunctionStatement>("print", std::vector<std::string>{"param"});
+        auto modules = generateModules(functions, protos, llvm::DataLayout(""), "", 1);
+        if (modules.size() != definitions.size()) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        // Loops and recursion keep a def pure, but it might not return; arrays and impure callees make it impure.
+        const std::vector<std::tuple<std::string, bool, bool, bool> > expected{
+            {"square", true, true, true},
+            {"loud", false, false, false},
+            {"sumSquares", true, false, false},
+            {"viaLoud", false, false, false},
+            {"factorial", true, false, false},
+            {"norm", false, false, false},
+            {"cube", true, true, true},
+        };
+        for (const auto &[name, pure, willReturn, speculatable]: expected) {
+            const auto &proto = *protos.at(name);
+            if (proto.pure != pure || proto.willReturn != willReturn || proto.speculatable != speculatable) {
+                throw std::logic_error(makeTestFailMsg(__LINE__));
+            }
+        }
+        // Definitions and the declarations in the modules of callers carry the attributes.
+        modules[2].withModuleDo([](const llvm::Module &module) {
+            const auto *const sumSquares = module.getFunction("sumSquares");
+            const auto *const square = module.getFunction("square");
+            if (!sumSquares->doesNotAccessMemory() || sumSquares->willReturn()
+                || sumSquares->hasFnAttribute(llvm::Attribute::Speculatable) || !square->doesNotAccessMemory()
+                || !square->doesNotThrow() || !square->willReturn()
+                || !square->hasFnAttribute(llvm::Attribute::Speculatable)) {
+                throw std::logic_error(makeTestFailMsg(__LINE__));
+            }
+        });
+    }
+
+    void testFastMath() {
+        const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(R"(
+            def fused(x) fast(reassoc, contract) { x * x + 1.5; }
+            def plain(x) { x * x + 1.5; }
+            def exact(x) strict { x * x + 1.5; }
+            def loose(x) fast { x * x + 1.5; }
+        )"));
+        std::vector<std::unique_ptr<FunctionNode> > definitions;
+        lexer->readNextToken();
+        while (lexer->getCurrentToken() == TokenType::FunctionDefinitionToken) {
+            definitions.push_back(parseFunctionDefinition(lexer));
+            if (definitions.back() == nullptr) {
+                throw std::logic_error(makeTestFailMsg(__LINE__));
+            }
+            lexer->readNextToken(); // eat '}'
+        }
+        std::vector<const FunctionNode *> functions;
+        for (const auto &definition: definitions) {
+            functions.push_back(definition.get());
+        }
+        // The defaults apply to plain only, the attributes of the other defs replace them.
+        FastMath defaultFastMath;
+        defaultFastMath.set("nsz");
+        std::unordered_map<std::string, std::unique_ptr<ProtoFunctionStatement> > protos;
+        auto modules = generateModules(functions, protos, llvm::DataLayout(""), "", 1, defaultFastMath);
+        if (modules.size() != definitions.size()) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        llvm::FastMathFlags fused;
+        fused.setAllowReassoc();
+        fused.setAllowContract();
+        llvm::FastMathFlags plain;
+        plain.setNoSignedZeros();
+        auto loose = fused;
+        loose.setNoNaNs();
+        loose.setNoInfs();
+        loose.setNoSignedZeros();
+        loose.setAllowReciprocal();
+        const std::vector<std::pair<std::string, llvm::FastMathFlags> > expected{
+            {"fused", fused},
+            {"plain", plain},
+            {"exact", {}},
+            {"loose", loose},
+        };
+        for (std::size_t i = 0; i < expected.size(); ++i) {
+            modules[i].withModuleDo([&expected, i](const llvm::Module &module) {
+                std::size_t operations = 0;
+                for (const auto &instruction: llvm::instructions(*module.getFunction(expected[i].first))) {
+                    if (const auto *const operation = llvm::dyn_cast<llvm::FPMathOperator>(&instruction)) {
+                        ++operations;
+                        if (operation->getFastMathFlags() != expected[i].second) {
+                            throw std::logic_error(makeTestFailMsg(__LINE__));
+                        }
+                    }
+                }
+                if (operations == 0) {
+                    throw std::logic_error(makeTestFailMsg(__LINE__));
+                }
+            });
+        }
+        modules[3].withModuleDo([](const llvm::Module &module) {
+            if (!module.getFunction("loose")->hasFnAttribute("no-nans-fp-math")) {
+                throw std::logic_error(makeTestFailMsg(__LINE__));
+            }
+        });
+
+        const auto invalid = std::make_unique<Lexer>(
+            std::make_unique<std::istringstream>("def f(x) fast(nonsense) { x; }"));
+        invalid->readNextToken();
+        if (parseFunctionDefinition(invalid) != nullptr) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+    }
+
+    void testTypeInference() {
+        const auto lexer = std::make_unique<Lexer>(std::make_unique<std::istringstream>(R"(
+            def f(n) {
+                s = 0;
+                for (i = 0, i < n, ++i) {
+                    s = s + i * 2;
+                }
+                x = s / 2;
+                y = 1;
+                y = y + 0.5;
+                b = s < 3;
+                s;
+            }
+        )"));
+        lexer->readNextToken();
+        const auto func = parseFunctionDefinition(lexer);
+        if (func == nullptr) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        const auto types = inferVariableTypes(func.get());
+        if (types.at("n") != ValueType::Double) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        // Only the loop index is an integer, a variable assigned integers may accumulate past 64 bits.
+        if (types.at("s") != ValueType::Double || types.at("i") != ValueType::Integer) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        if (types.at("x") != ValueType::Double || types.at("y") != ValueType::Double) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        if (types.at("b") != ValueType::Boolean) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+    }
 } // namespace
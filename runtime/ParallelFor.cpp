@@ -0,0 +1,135 @@
+#include "ParallelFor.h"
+
+#include <algorithm>
+
+namespace {
+    // Set on the threads running iterations, which run nested loops themselves.
+    thread_local bool inParallelLoop = false;
+
+    // Ranges per thread: enough to even out iterations of different cost without paying for tiny chunks.
+    constexpr std::int64_t rangesPerThread = 8;
+} // namespace
+
+WorkStealingPool::WorkStealingPool(const unsigned threads) {
+    const auto count = std::max(threads, 1u);
+    for (unsigned i = 0; i < count; ++i) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 1; i < count; ++i) {
+        workers.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard lock(wakeMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &worker: workers) {
+        worker.join();
+    }
+}
+
+void WorkStealingPool::run(const ParallelForBody body, void *const context, const std::int64_t begin,
+                           const std::int64_t end) {
+    if (begin >= end) {
+        return;
+    }
+    std::unique_lock loopLock(loopMutex, std::try_to_lock);
+    if (inParallelLoop || !loopLock.owns_lock() || workers.empty()) {
+        body(context, begin, end);
+        return;
+    }
+    this->body = body;
+    this->context = context;
+    grain = std::max<std::int64_t>((end - begin) / (static_cast<std::int64_t>(queues.size()) * rangesPerThread), 1);
+    remaining.store(end - begin, std::memory_order_relaxed);
+    {
+        std::lock_guard lock(queues.front()->mutex);
+        queues.front()->ranges.push_back({begin, end});
+    }
+    {
+        std::lock_guard lock(wakeMutex);
+        ++loops;
+    }
+    wake.notify_all();
+    inParallelLoop = true;
+    work(0);
+    inParallelLoop = false;
+}
+
+WorkStealingPool &WorkStealingPool::global() {
+    static WorkStealingPool pool(std::thread::hardware_concurrency());
+    return pool;
+}
+
+void WorkStealingPool::workerLoop(const unsigned self) {
+    inParallelLoop = true;
+    std::uint64_t seenLoops = 0;
+    while (true) {
+        {
+            std::unique_lock lock(wakeMutex);
+            wake.wait(lock, [this, seenLoops] { return stopping || loops != seenLoops; });
+            if (stopping) {
+                return;
+            }
+            seenLoops = loops;
+        }
+        work(self);
+    }
+}
+
+void WorkStealingPool::work(const unsigned self) {
+    Range range{};
+    while (remaining.load(std::memory_order_acquire) > 0) {
+        if (takeRange(self, range)) {
+            execute(self, range);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool WorkStealingPool::takeRange(const unsigned self, Range &range) {
+    // The most recently split range of the own queue is the smallest and the warmest in the cache.
+    {
+        auto &queue = *queues[self];
+        std::lock_guard lock(queue.mutex);
+        if (!queue.ranges.empty()) {
+            range = queue.ranges.back();
+            queue.ranges.pop_back();
+            return true;
+        }
+    }
+    // Thieves take the oldest, i.e. biggest, range of another queue.
+    for (std::size_t i = 1; i < queues.size(); ++i) {
+        auto &queue = *queues[(self + i) % queues.size()];
+        std::lock_guard lock(queue.mutex);
+        if (!queue.ranges.empty()) {
+            range = queue.ranges.front();
+            queue.ranges.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::execute(const unsigned self, Range range) {
+    while (range.end - range.begin > grain) {
+        const auto middle = range.begin + (range.end - range.begin) / 2;
+        {
+            auto &queue = *queues[self];
+            std::lock_guard lock(queue.mutex);
+            queue.ranges.push_back({middle, range.end});
+        }
+        range.end = middle;
+    }
+    body(context, range.begin, range.end);
+    remaining.fetch_sub(range.end - range.begin, std::memory_order_acq_rel);
+}
+
+extern "C" void simple_ast_parallel_for(const ParallelForBody body, void *const context, const std::int64_t begin,
+                                        const std::int64_t end) {
+    WorkStealingPool::global().run(body, context, begin, end);
+}
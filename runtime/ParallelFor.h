@@ -0,0 +1,80 @@
+#ifndef PARALLELFOR_H
+#define PARALLELFOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Body of a parfor loop outlined by IRCodegen: runs the iterations [begin, end) with the captured values of the
+// enclosing function in context.
+using ParallelForBody = void (*)(void *context, std::int64_t begin, std::int64_t end);
+
+// Runs the iterations of one parallel loop at a time on worker threads and the calling thread. The iteration range
+// is split in halves until it is no larger than the grain; each worker runs the lower half itself and queues the
+// upper one, which idle workers steal from the front of its queue, so that the chunks adapt to the load: busy
+// workers keep splitting their own ranges, idle ones take the biggest pending ones.
+class WorkStealingPool final {
+public:
+    explicit WorkStealingPool(unsigned threads);
+
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    // Returns once every iteration ran. A loop started while another one runs, e.g. a parfor nested in the body of
+    // a parfor or one started by a concurrent thread, runs on the calling thread.
+    void run(ParallelForBody body, void *context, std::int64_t begin, std::int64_t end);
+
+    // The pool parfor loops run on, with a thread per core.
+    static WorkStealingPool &global();
+
+private:
+    struct Range {
+        std::int64_t begin;
+        std::int64_t end;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Range> ranges;
+    };
+
+    void workerLoop(unsigned self);
+
+    // Runs ranges until no iteration of the current loop is left.
+    void work(unsigned self);
+
+    bool takeRange(unsigned self, Range &range);
+
+    void execute(unsigned self, Range range);
+
+    // Queue 0 belongs to the thread which runs the loop, the others to the workers.
+    std::vector<std::unique_ptr<Queue> > queues;
+    std::vector<std::thread> workers;
+    std::mutex loopMutex;
+
+    // The current loop. Written before its range is queued, read after a range was taken from a queue.
+    ParallelForBody body = nullptr;
+    void *context = nullptr;
+    std::int64_t grain = 1;
+    std::atomic<std::int64_t> remaining{0};
+
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::uint64_t loops = 0;
+    bool stopping = false;
+};
+
+// Entry point of the runtime which the code of parfor loops calls, see parallelForSymbol.
+extern "C" void simple_ast_parallel_for(ParallelForBody body, void *context, std::int64_t begin, std::int64_t end);
+
+inline constexpr char parallelForSymbol[] = "simple_ast_parallel_for";
+
+#endif //PARALLELFOR_H
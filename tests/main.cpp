@@ -2,9 +2,12 @@
 // Created by vadim on 14.12.24.
 //
 
+#include <cmath>
 #include <functional>
 #include <memory>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 #include "Lexer.h"
 #include "Parser.h"
@@ -12,6 +15,13 @@
 #include "ast/BaseNode.h"
 #include "ast/VariableDefinitionStatement.h"
 #include "Util.h"
+#include "engine/Engine.h"
+#include "engine/HostFunctions.h"
+
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
 
 namespace {
     std::string makeTestFailMsg(const std::uint32_t line) {
@@ -124,11 +134,361 @@ namespace {
             }
         }
     }
+
+    void testEngine() {
+        auto engine = llvm::cantFail(Engine::Create());
+        llvm::cantFail(engine->compile(R"(
+            def square(x) { x * x; }
+            def hypot2(a, b) { square(a) + square(b); }
+        )"));
+        auto *const hypot2 = llvm::cantFail(engine->lookup<double(double, double)>("hypot2"));
+        if (hypot2(3, 4) != 25) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        // Wrong arity, unknown names, redefinitions and expressions passed to compile() are errors.
+        if (auto wrongArity = engine->lookup<double(double)>("hypot2"); wrongArity) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        } else {
+            llvm::consumeError(wrongArity.takeError());
+        }
+        if (auto unknown = engine->lookup<double(double)>("cube"); unknown) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        } else {
+            llvm::consumeError(unknown.takeError());
+        }
+        if (auto error = engine->compile("def square(x) { x; }")) {
+            llvm::consumeError(std::move(error));
+        } else {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        if (auto error = engine->compile("square(2);")) {
+            llvm::consumeError(std::move(error));
+        } else {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+
+        // Products of integers are computed in double precision, 25! doesn't fit into 64 bits.
+        llvm::cantFail(engine->compile("def factorial(n) { r = 1; for (i = 1, i < n + 1, ++i) { r = r * i; } r; }"));
+        double factorial = 1;
+        for (auto i = 1; i <= 25; ++i) {
+            factorial *= i;
+        }
+        if (llvm::cantFail(engine->lookup<double(double)>("factorial"))(25) != factorial) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+
+        // Builtins without a native instruction become calls of libm, and loops filling an array a memset, which the
+        // engine resolves without the symbols of the process.
+        llvm::cantFail(engine->compile(R"(
+            def waves(x, y) { sin(x) + exp(y) + pow(x, y) + floor(y); }
+            def clear(a[]) { for (i = 0, i < len(a), ++i) { a[i] = 0; } len(a); }
+        )"));
+        if (llvm::cantFail(engine->lookup<double(double, double)>("waves"))(0.5, 1.5)
+            != std::sin(0.5) + std::exp(1.5) + std::pow(0.5, 1.5) + std::floor(1.5)) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        std::vector<double> cleared(1000, 1);
+        llvm::cantFail(engine->lookup<double(double *, std::size_t)>("clear"))(cleared.data(), cleared.size());
+        if (cleared != std::vector<double>(1000, 0)) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+
+        // Compilation, evaluation and calls from many threads at once.
+        std::vector<std::thread> threads;
+        std::vector<double> results(8);
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            threads.emplace_back([&engine, &results, i] {
+                const auto index = std::to_string(i);
+                llvm::cantFail(engine->compile("def offset" + index + "(x) { hypot2(x, 0) + " + index + "; }"));
+                auto *const offset = llvm::cantFail(engine->lookup<double(double)>("offset" + index));
+                results[i] = offset(2) + llvm::cantFail(engine->evaluate("offset" + index + "(1);"));
+            });
+        }
+        for (auto &thread: threads) {
+            thread.join();
+        }
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            if (results[i] != 5 + 2 * static_cast<double>(i)) {
+                throw std::logic_error(makeTestFailMsg(__LINE__));
+            }
+        }
+    }
+
+    double hostScale(const double x, const double factor) {
+        return x * factor;
+    }
+
+    void testHostFunctions() {
+        // A bitcode builtin: double twice(double x) { return x + x; }, marked readnone.
+        std::string bitcode;
+        {
+            llvm::LLVMContext context;
+            llvm::Module module("builtins", context);
+            llvm::IRBuilder<> builder(context);
+            auto *const function = llvm::Function::Create(
+                    llvm::FunctionType::get(builder.getDoubleTy(), {builder.getDoubleTy()}, false),
+                    llvm::Function::ExternalLinkage, "twice", module);
+            function->setDoesNotAccessMemory();
+            builder.SetInsertPoint(llvm::BasicBlock::Create(context, "entry", function));
+            builder.CreateRet(builder.CreateFAdd(function->getArg(0), function->getArg(0)));
+            llvm::raw_string_ostream os(bitcode);
+            llvm::WriteBitcodeToFile(module, os);
+        }
+
+        EngineOptions options;
+        options.hostFunctions.add("scale", &hostScale, true);
+        llvm::cantFail(options.hostFunctions.addBitcode(llvm::MemoryBufferRef(bitcode, "builtins")));
+        const auto &functions = options.hostFunctions.getFunctions();
+        if (functions.size() != 2 || functions[1].name != "twice" || functions[1].arity != 1 || !functions[1].pure) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        auto engine = llvm::cantFail(Engine::Create(options));
+        llvm::cantFail(engine->compile("def f(x) { scale(twice(x), 3); }"));
+        auto *const f = llvm::cantFail(engine->lookup<double(double)>("f"));
+        if (f(2) != 12) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        // Functions of the process which weren't registered can't be called.
+        if (auto error = engine->compile("def g(x) { cos(x); }")) {
+            llvm::consumeError(std::move(error));
+        } else {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+    }
+
+    void testBatchEvaluation() {
+        auto engine = llvm::cantFail(Engine::Create());
+        llvm::cantFail(engine->compile("def f(a, b, c) { if (c < 0) { a; } else { a * b + c; } }"));
+        auto *const f = llvm::cantFail(engine->lookup<double(double, double, double)>("f"));
+        auto *const fBatch = llvm::cantFail(engine->lookupBatch("f"));
+        // An odd number of rows leaves a remainder after the vector loop.
+        constexpr std::size_t rows = 1003;
+        std::vector<double> a(rows);
+        std::vector<double> b(rows);
+        std::vector<double> c(rows);
+        for (std::size_t row = 0; row < rows; ++row) {
+            a[row] = static_cast<double>(row);
+            b[row] = 0.5;
+            c[row] = static_cast<double>(row % 7) - 3;
+        }
+        const double *const columns[] = {a.data(), b.data(), c.data()};
+        std::vector<double> out(rows + 1, -1);
+        fBatch(columns, out.data(), rows);
+        for (std::size_t row = 0; row < rows; ++row) {
+            if (out[row] != f(a[row], b[row], c[row])) {
+                throw std::logic_error(makeTestFailMsg(__LINE__));
+            }
+        }
+        fBatch(columns, out.data(), 0);
+        if (out[0] != f(a[0], b[0], c[0]) || out[rows] != -1) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        if (auto unknown = engine->lookupBatch("g"); unknown) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        } else {
+            llvm::consumeError(unknown.takeError());
+        }
+    }
+
+    void testArrays() {
+        auto engine = llvm::cantFail(Engine::Create());
+        llvm::cantFail(engine->compile(R"(
+            def total(a[]) { s = 0; for (i = 0, i < len(a), ++i) { s = s + a[i]; } s; }
+            def scale(a[], k) { for (i = 0, i < len(a), ++i) { a[i] = a[i] * k; } len(a); }
+            def scaledTotal(k, a[]) { scale(a, k); total(a); }
+        )"));
+        auto *const total = llvm::cantFail(engine->lookup<double(const double *, std::size_t)>("total"));
+        auto *const scaledTotal = llvm::cantFail(
+            engine->lookup<double(double, double *, std::size_t)>("scaledTotal"));
+        std::vector<double> data{1, 2, 3, 4, 5};
+        if (total(data.data(), data.size()) != 15 || total(data.data(), 0) != 0) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        // The script writes the buffer of the host in place.
+        if (scaledTotal(2, data.data(), 4) != 20 || data != std::vector<double>{2, 4, 6, 8, 5}) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        // An array arg is a pointer and a length, and has no batch function.
+        if (auto wrongArity = engine->lookup<double(const double *)>("total"); wrongArity) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        } else {
+            llvm::consumeError(wrongArity.takeError());
+        }
+        // Signatures of the right arity still pass every arg the way the def takes it.
+        if (auto scalars = engine->lookup<double(double, double)>("total"); scalars) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        } else {
+            llvm::consumeError(scalars.takeError());
+        }
+        if (auto swapped = engine->lookup<double(double *, std::size_t, double)>("scaledTotal"); swapped) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        } else {
+            llvm::consumeError(swapped.takeError());
+        }
+        if (auto batch = engine->lookupBatch("total"); batch) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        } else {
+            llvm::consumeError(batch.takeError());
+        }
+        // Arrays are no scalars, and scalars no arrays.
+        for (const auto *const source: {
+                 "def bad1(a[]) { a + 1; }", "def bad2(x) { x[0]; }", "def bad3(x) { total(x); }"
+             }) {
+            if (auto error = engine->compile(source)) {
+                llvm::consumeError(std::move(error));
+            } else {
+                throw std::logic_error(makeTestFailMsg(__LINE__));
+            }
+        }
+    }
+
+    void testParallelFor() {
+        auto engine = llvm::cantFail(Engine::Create());
+        llvm::cantFail(engine->compile(R"(
+            def fill(out[], k) { parfor (i = 0, i < len(out)) { x = i * k; out[i] = x + 1; } len(out); }
+            def fillRows(out[], columns) {
+                parfor (row = 0, row < len(out) / columns) {
+                    parfor (column = 0, column < columns) { out[row * columns + column] = row; }
+                }
+                0;
+            }
+        )"));
+        auto *const fill = llvm::cantFail(engine->lookup<double(double *, std::size_t, double)>("fill"));
+        std::vector<double> data(100'003);
+        if (fill(data.data(), data.size(), 2) != static_cast<double>(data.size())) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        for (std::size_t i = 0; i < data.size(); ++i) {
+            if (data[i] != 2 * static_cast<double>(i) + 1) {
+                throw std::logic_error(makeTestFailMsg(__LINE__));
+            }
+        }
+        // Nested loops run their iterations on the thread which runs the outer iteration.
+        auto *const fillRows = llvm::cantFail(engine->lookup<double(double *, std::size_t, double)>("fillRows"));
+        fillRows(data.data(), 1000 * 100, 100);
+        for (std::size_t i = 0; i < 1000 * 100; ++i) {
+            if (data[i] != static_cast<double>(i / 100)) {
+                throw std::logic_error(makeTestFailMsg(__LINE__));
+            }
+        }
+        // Iterations can't assign the locals of the function, nor the loop variable.
+        for (const auto *const source: {
+                 "def bad1(a[]) { s = 0; parfor (i = 0, i < len(a)) { s = s + a[i]; } s; }",
+                 "def bad2(a[]) { parfor (i = 0, i < len(a)) { i = i + 1; } 0; }"
+             }) {
+            if (auto error = engine->compile(source)) {
+                llvm::consumeError(std::move(error));
+            } else {
+                throw std::logic_error(makeTestFailMsg(__LINE__));
+            }
+        }
+    }
+
+    void testReductions() {
+        auto engine = llvm::cantFail(Engine::Create());
+        llvm::cantFail(engine->compile(R"(
+            def dot(a[], b[]) { sum(i = 0, len(a)) { a[i] * b[i] }; }
+            def parallelDot(a[], b[]) { parsum(i = 0, len(a)) { a[i] * b[i] }; }
+            def range(a[]) { max(i = 0, len(a)) { a[i] } - min(i = 0, len(a)) { a[i] }; }
+            def parallelRange(a[]) { parmax(i = 0, len(a)) { a[i] } - parmin(i = 0, len(a)) { a[i] }; }
+            def factorial(n) { product(i = 1, n + 1) { i }; }
+            def triangle(n) { parsum(i = 0, n) { i }; }
+            def empty() { sum(i = 1, 0) { 1 } + product(i = 1, 0) { 2 }; }
+        )"));
+        std::vector<double> a(100'003);
+        std::vector<double> b(a.size());
+        for (std::size_t i = 0; i < a.size(); ++i) {
+            a[i] = static_cast<double>(i % 7) - 3;
+            b[i] = static_cast<double>(i % 5);
+        }
+        double expected = 0;
+        for (std::size_t i = 0; i < a.size(); ++i) {
+            expected += a[i] * b[i];
+        }
+        using DotFunction = double(const double *, std::size_t, const double *, std::size_t);
+        // The products are small integers, so the sum is exact in any order.
+        for (const auto *const name: {"dot", "parallelDot"}) {
+            auto *const dot = llvm::cantFail(engine->lookup<DotFunction>(name));
+            if (dot(a.data(), a.size(), b.data(), b.size()) != expected) {
+                throw std::logic_error(makeTestFailMsg(__LINE__));
+            }
+        }
+        for (const auto *const name: {"range", "parallelRange"}) {
+            auto *const range = llvm::cantFail(engine->lookup<double(const double *, std::size_t)>(name));
+            if (range(a.data(), a.size()) != 6) {
+                throw std::logic_error(makeTestFailMsg(__LINE__));
+            }
+        }
+        // Integer bodies reduce exactly below 2^53, and in double precision above.
+        auto *const factorial = llvm::cantFail(engine->lookup<double(double)>("factorial"));
+        auto *const triangle = llvm::cantFail(engine->lookup<double(double)>("triangle"));
+        double factorial25 = 1;
+        for (int i = 2; i <= 25; ++i) {
+            factorial25 *= i;
+        }
+        if (factorial(10) != 3'628'800 || factorial(25) != factorial25 || triangle(100'000) != 4'999'950'000.0
+            || triangle(3) != 3) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        // Empty ranges give the identity.
+        if (llvm::cantFail(engine->lookup<double()>("empty"))() != 1) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        // Without a definition of the index the builtin and the defs are called as usual.
+        if (llvm::cantFail(engine->evaluate("min(2, 3) + max(2, 3);")) != 5) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+    }
+
+    void testGlobals() {
+        auto engine = llvm::cantFail(Engine::Create());
+        // Assignments of top-level expressions outlive the evaluation.
+        if (llvm::cantFail(engine->evaluate("total = 10; step = 2.5; total;")) != 10
+            || llvm::cantFail(engine->evaluate("total = total + step; total;")) != 12.5) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        // Defs read globals, but a variable they assign is their own.
+        llvm::cantFail(engine->compile(R"(
+            def scaled(x) { x * step; }
+            def shadowed(x) { step = x; step + total; }
+        )"));
+        auto *const scaled = llvm::cantFail(engine->lookup<double(double)>("scaled"));
+        auto *const shadowed = llvm::cantFail(engine->lookup<double(double)>("shadowed"));
+        if (scaled(2) != 5 || shadowed(1) != 13.5 || llvm::cantFail(engine->evaluate("step;")) != 2.5) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        // The host writes globals in place, compiled code reads the new value.
+        auto *const step = llvm::cantFail(engine->global("step"));
+        if (*step != 2.5) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        *step = 4;
+        if (scaled(2) != 8) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        // A global created by the host is 0 until assigned, and visible to defs compiled afterwards.
+        auto *const rate = llvm::cantFail(engine->global("rate"));
+        if (*rate != 0) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+        *rate = 0.5;
+        llvm::cantFail(engine->compile("def discount(x) { x * rate; }"));
+        if (llvm::cantFail(engine->lookup<double(double)>("discount"))(10) != 5) {
+            throw std::logic_error(makeTestFailMsg(__LINE__));
+        }
+    }
 } // namespace
 
 
 int main(int argc, const char *argv[]) {
     testVarDefinition();
     testParseBinExpression();
+    testEngine();
+    testHostFunctions();
+    testBatchEvaluation();
+    testArrays();
+    testParallelFor();
+    testReductions();
+    testGlobals();
     return 0;
 }